@@ -0,0 +1,169 @@
+#ifndef ARENA_ALLOCATOR_H
+#define ARENA_ALLOCATOR_H
+
+#include <cstddef> // std::size_t
+#include <new>     // ::operator new, ::operator delete, std::bad_alloc
+#include <vector>
+
+/**
+ * Arena di memoria a crescita monotona: le richieste vengono servite
+ * avanzando un puntatore all'interno di blocchi contigui e la memoria
+ * viene restituita tutta insieme con release() o alla distruzione.
+ *
+ * Pensata per costruire molte matrici temporanee (ad esempio in un
+ * passo di calcolo) e rilasciarle in un colpo solo, senza pagare una
+ * chiamata all'allocatore di sistema per ogni riallocazione.
+ *
+ * @brief Arena di memoria
+ */
+class sparse_arena
+{
+public:
+  /**
+   * Costruttore.
+   *
+   * @param chunk_size dimensione in byte dei blocchi richiesti al sistema
+   */
+  explicit sparse_arena(std::size_t chunk_size = 1 << 16)
+      : _chunk_size(chunk_size), _cur(nullptr), _end(nullptr) {}
+
+  /**
+   * Distruttore: restituisce al sistema tutti i blocchi.
+   */
+  ~sparse_arena()
+  {
+    release();
+  }
+
+  /**
+   * Ritorna un blocco di almeno bytes byte allineato ad align.
+   *
+   * @param bytes numero di byte richiesti
+   * @param align allineamento richiesto (potenza di 2)
+   * @return puntatore al blocco
+   *
+   * @throw std::bad_alloc se la memoria non e' disponibile
+   */
+  void *allocate(std::size_t bytes, std::size_t align)
+  {
+    char *p = align_up(_cur, align);
+    if (_cur == nullptr || p + bytes > _end)
+    {
+      std::size_t size = bytes + align;
+      if (size < _chunk_size)
+        size = _chunk_size;
+      char *chunk = static_cast<char *>(::operator new(size));
+      try
+      {
+        _chunks.push_back(chunk);
+      }
+      catch (...)
+      {
+        ::operator delete(chunk);
+        throw;
+      }
+      _end = chunk + size;
+      p = align_up(chunk, align);
+    }
+    _cur = p + bytes;
+    return p;
+  }
+
+  /**
+   * Restituisce al sistema tutti i blocchi dell'arena. Tutta la memoria
+   * ottenuta in precedenza diventa non valida.
+   */
+  void release()
+  {
+    for (std::size_t i = 0; i < _chunks.size(); i++)
+      ::operator delete(_chunks[i]);
+    _chunks.clear();
+    _cur = nullptr;
+    _end = nullptr;
+  }
+
+  /**
+   * Ritorna il numero di blocchi attualmente richiesti al sistema.
+   *
+   * @return numero di blocchi
+   */
+  std::size_t get_chunks() const { return _chunks.size(); }
+
+private:
+  std::size_t _chunk_size;    ///< dimensione minima dei blocchi
+  std::vector<char *> _chunks; ///< blocchi richiesti al sistema
+  char *_cur;                 ///< prima posizione libera del blocco corrente
+  char *_end;                 ///< fine del blocco corrente
+
+  sparse_arena(const sparse_arena &);
+  sparse_arena &operator=(const sparse_arena &);
+
+  static char *align_up(char *p, std::size_t align)
+  {
+    std::size_t addr = reinterpret_cast<std::size_t>(p);
+    return p + ((align - addr % align) % align);
+  }
+
+}; // END class sparse_arena
+
+/**
+ * Allocatore che preleva la memoria da una sparse_arena. deallocate non
+ * esegue alcuna operazione: la memoria torna disponibile solo con
+ * sparse_arena::release(). Utilizzabile come parametro A di sparse_matrix.
+ *
+ * @brief Allocatore su arena
+ *
+ * @param T tipo degli oggetti allocati
+ */
+template <typename T>
+class arena_allocator
+{
+public:
+  typedef T value_type;
+
+  /**
+   * Costruttore.
+   *
+   * @param arena arena da cui prelevare la memoria
+   */
+  arena_allocator(sparse_arena &arena) : _arena(&arena) {}
+
+  /**
+   * Costruttore di conversione da un allocatore di un altro tipo
+   * (usato dal rebind).
+   */
+  template <typename U>
+  arena_allocator(const arena_allocator<U> &other) : _arena(other.arena()) {}
+
+  T *allocate(std::size_t n)
+  {
+    return static_cast<T *>(_arena->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T *, std::size_t) {}
+
+  /**
+   * Ritorna l'arena da cui l'allocatore preleva la memoria.
+   *
+   * @return puntatore all'arena
+   */
+  sparse_arena *arena() const { return _arena; }
+
+private:
+  sparse_arena *_arena; ///< arena da cui prelevare la memoria
+
+}; // END class arena_allocator
+
+template <typename T, typename U>
+bool operator==(const arena_allocator<T> &a, const arena_allocator<U> &b)
+{
+  return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const arena_allocator<T> &a, const arena_allocator<U> &b)
+{
+  return a.arena() != b.arena();
+}
+
+#endif // ARENA_ALLOCATOR_H
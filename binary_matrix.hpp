@@ -0,0 +1,373 @@
+#ifndef BINARY_MATRIX_H
+#define BINARY_MATRIX_H
+
+#include <cstddef>     // std::size_t, std::max_align_t
+#include <cstdint>     // std::uint32_t, std::uint64_t
+#include <cstring>     // std::memcpy, std::memcmp
+#include <istream>     // std::istream
+#include <ostream>     // std::ostream
+#include <fstream>     // std::ifstream, std::ofstream
+#include <iterator>    // std::istreambuf_iterator
+#include <limits>      // std::numeric_limits
+#include <memory>      // std::shared_ptr
+#include <stdexcept>   // std::runtime_error
+#include <string>      // std::string
+#include <type_traits> // std::is_trivially_copyable
+#include <vector>      // std::vector
+#include "sparse_matrix.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>    // open
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close
+#define SPARSE_BINARY_MMAP 1
+#endif
+
+/**
+ * Formato binario su disco di una matrice CSR, pensato per essere mappato
+ * in memoria e usato direttamente, senza interpretazione ne' copie:
+ *
+ *   header | default | row_ptr (uint64) | col_idx (uint32) | values (T)
+ *
+ * Ogni sezione inizia a un offset multiplo di 64 byte (le sezioni sono
+ * separate da byte di riempimento nulli), cosi' che gli array mappati
+ * siano allineati per qualunque tipo di dato. Interi e valori sono
+ * memorizzati nella rappresentazione nativa della macchina: il campo
+ * endian del header permette di rifiutare file scritti con un ordine dei
+ * byte diverso.
+ */
+namespace sparse_binary
+{
+
+static const std::uint32_t version = 1;             ///< versione del formato
+static const std::uint32_t endian_tag = 0x01020304; ///< ordine dei byte
+static const std::uint64_t alignment = 64;          ///< allineamento sezioni
+
+/**
+ * Intestazione del file, all'offset 0.
+ */
+struct file_header
+{
+  char magic[8];              ///< "SPMXBIN" terminato da zero
+  std::uint32_t version;      ///< versione del formato
+  std::uint32_t endian;       ///< endian_tag scritto in ordine nativo
+  std::uint32_t value_kind;   ///< 'f' reale, 'i' con segno, 'u' senza, 'o'
+  std::uint32_t value_size;   ///< sizeof(T)
+  std::uint32_t index_size;   ///< byte di un indice di colonna
+  std::uint32_t offset_size;  ///< byte di un offset di riga
+  std::uint64_t rows;         ///< numero di righe
+  std::uint64_t cols;         ///< numero di colonne
+  std::uint64_t nnz;          ///< numero di elementi memorizzati
+  std::uint64_t default_pos;  ///< offset del valore di default
+  std::uint64_t row_ptr_pos;  ///< offset degli offset di riga
+  std::uint64_t col_idx_pos;  ///< offset degli indici di colonna
+  std::uint64_t values_pos;   ///< offset dei valori
+  std::uint64_t file_size;    ///< dimensione totale del file
+};
+
+static_assert(sizeof(file_header) == 96,
+              "sparse_binary: layout del header inatteso");
+
+inline const char *magic() { return "SPMXBIN"; }
+
+inline std::uint64_t align_up(std::uint64_t pos)
+{
+  return (pos + alignment - 1) / alignment * alignment;
+}
+
+template <typename T>
+std::uint32_t kind()
+{
+  return std::is_floating_point<T>::value ? 'f'
+         : !std::is_integral<T>::value    ? 'o'
+         : std::is_signed<T>::value       ? 'i'
+                                          : 'u';
+}
+
+/**
+ * Funzione di supporto che verifica l'immagine del file [base, base + size)
+ * e costruisce la csr_matrix che ne usa direttamente gli array.
+ *
+ * @param verify se true controlla anche che gli offset di riga siano
+ *        crescenti e che gli indici di colonna siano crescenti nella riga
+ *        e minori del numero di colonne, O(nnz)
+ *
+ * @throw std::runtime_error se il file non e' valido
+ */
+template <typename T, typename E>
+csr_matrix<T, E> from_image(const char *base, std::uint64_t size,
+                            const std::shared_ptr<const void> &owner,
+                            bool verify)
+{
+  typedef typename csr_matrix<T, E>::offset_type offset_type;
+  typedef typename csr_matrix<T, E>::index_type index_type;
+
+  file_header h;
+  if (size < sizeof(h))
+    throw std::runtime_error("sparse_binary: file troppo corto");
+  std::memcpy(&h, base, sizeof(h));
+
+  if (std::memcmp(h.magic, magic(), sizeof(h.magic)) != 0)
+    throw std::runtime_error("sparse_binary: file non riconosciuto");
+  if (h.version != version)
+    throw std::runtime_error("sparse_binary: versione non supportata");
+  if (h.endian != endian_tag)
+    throw std::runtime_error("sparse_binary: ordine dei byte diverso");
+  if (h.value_kind != kind<T>() || h.value_size != sizeof(T) ||
+      h.index_size != sizeof(index_type) ||
+      h.offset_size != sizeof(offset_type))
+    throw std::runtime_error("sparse_binary: tipo dei dati diverso");
+  if (h.file_size != size ||
+      h.rows > std::numeric_limits<unsigned int>::max() ||
+      h.cols > std::numeric_limits<unsigned int>::max() || h.nnz > size)
+    throw std::runtime_error("sparse_binary: dimensioni non valide");
+
+  const std::uint64_t pos[] = {h.default_pos, h.row_ptr_pos, h.col_idx_pos,
+                               h.values_pos};
+  const std::uint64_t len[] = {sizeof(T), (h.rows + 1) * sizeof(offset_type),
+                               h.nnz * sizeof(index_type), h.nnz * sizeof(T)};
+  for (unsigned int i = 0; i < 4; i++)
+    if (pos[i] % alignment != 0 || pos[i] > size || len[i] > size - pos[i])
+      throw std::runtime_error("sparse_binary: sezione fuori dal file");
+
+  const offset_type *row_ptr =
+      reinterpret_cast<const offset_type *>(base + h.row_ptr_pos);
+  const index_type *col_idx =
+      reinterpret_cast<const index_type *>(base + h.col_idx_pos);
+  const T *values = reinterpret_cast<const T *>(base + h.values_pos);
+
+  if (row_ptr[0] != 0 || row_ptr[h.rows] != h.nnz)
+    throw std::runtime_error("sparse_binary: offset di riga non validi");
+
+  if (verify)
+  {
+    for (std::uint64_t r = 0; r < h.rows; r++)
+    {
+      if (row_ptr[r] > row_ptr[r + 1])
+        throw std::runtime_error("sparse_binary: offset di riga non validi");
+      for (offset_type k = row_ptr[r]; k < row_ptr[r + 1]; k++)
+        if (col_idx[k] >= h.cols ||
+            (k > row_ptr[r] && col_idx[k] <= col_idx[k - 1]))
+          throw std::runtime_error("sparse_binary: indici di colonna non "
+                                   "validi");
+    }
+  }
+
+  T def;
+  std::memcpy(&def, base + h.default_pos, sizeof(T));
+
+  return csr_matrix<T, E>(static_cast<unsigned int>(h.rows),
+                          static_cast<unsigned int>(h.cols), def, row_ptr,
+                          col_idx, values, owner);
+}
+
+inline void write_section(std::ostream &out, std::uint64_t &pos,
+                          std::uint64_t at, const void *data,
+                          std::uint64_t bytes)
+{
+  static const char zeros[alignment] = {};
+  out.write(zeros, static_cast<std::streamsize>(at - pos));
+  out.write(static_cast<const char *>(data),
+            static_cast<std::streamsize>(bytes));
+  pos = at + bytes;
+}
+
+#ifdef SPARSE_BINARY_MMAP
+/**
+ * Deleter della mappatura: rilascia le pagine quando l'ultima matrice che
+ * le usa viene distrutta.
+ */
+struct unmapper
+{
+  std::size_t size;
+
+  void operator()(const void *p) const
+  {
+    ::munmap(const_cast<void *>(p), size);
+  }
+};
+#endif
+
+} // namespace sparse_binary
+
+/**
+ * Scrive una matrice CSR nel formato binario di sparse_binary.
+ *
+ * @param out stream di output (aperto in modalita' binaria)
+ * @param m matrice da scrivere
+ *
+ * @throw std::runtime_error se la scrittura fallisce
+ */
+template <typename T, typename E>
+void save_binary(std::ostream &out, const csr_matrix<T, E> &m)
+{
+  static_assert(std::is_trivially_copyable<T>::value,
+                "save_binary richiede un tipo copiabile byte per byte");
+
+  typedef typename csr_matrix<T, E>::offset_type offset_type;
+  typedef typename csr_matrix<T, E>::index_type index_type;
+  using namespace sparse_binary;
+
+  file_header h;
+  std::memset(&h, 0, sizeof(h));
+  std::memcpy(h.magic, magic(), sizeof(h.magic));
+  h.version = version;
+  h.endian = endian_tag;
+  h.value_kind = kind<T>();
+  h.value_size = sizeof(T);
+  h.index_size = sizeof(index_type);
+  h.offset_size = sizeof(offset_type);
+  h.rows = m.get_rows();
+  h.cols = m.get_columns();
+  h.nnz = m.get_size();
+  h.default_pos = align_up(sizeof(h));
+  h.row_ptr_pos = align_up(h.default_pos + sizeof(T));
+  h.col_idx_pos = align_up(h.row_ptr_pos + (h.rows + 1) * sizeof(offset_type));
+  h.values_pos = align_up(h.col_idx_pos + h.nnz * sizeof(index_type));
+  h.file_size = h.values_pos + h.nnz * sizeof(T);
+
+  std::uint64_t pos = 0;
+  write_section(out, pos, 0, &h, sizeof(h));
+  write_section(out, pos, h.default_pos, &m.get_default(), sizeof(T));
+  write_section(out, pos, h.row_ptr_pos, m.row_offsets(),
+                (h.rows + 1) * sizeof(offset_type));
+  write_section(out, pos, h.col_idx_pos, m.column_indices(),
+                h.nnz * sizeof(index_type));
+  write_section(out, pos, h.values_pos, m.values(), h.nnz * sizeof(T));
+
+  if (!out)
+    throw std::runtime_error("sparse_binary: errore di scrittura");
+}
+
+/**
+ * Scrive una sparse_matrix nel formato binario, passando per freeze().
+ *
+ * @param out stream di output (aperto in modalita' binaria)
+ * @param sm matrice da scrivere
+ *
+ * @throw std::runtime_error se la scrittura fallisce
+ * @throw eccezione di allocazione della memoria
+ */
+template <typename T, typename E, typename A, typename I>
+void save_binary(std::ostream &out, const sparse_matrix<T, E, A, I> &sm)
+{
+  save_binary(out, sm.freeze());
+}
+
+/**
+ * Scrive una matrice (csr_matrix o sparse_matrix) nel formato binario su
+ * file.
+ *
+ * @param path percorso del file
+ * @param m matrice da scrivere
+ *
+ * @throw std::runtime_error se il file non puo' essere scritto
+ */
+template <typename M>
+void save_binary(const std::string &path, const M &m)
+{
+  std::ofstream out(path.c_str(), std::ios::binary);
+  if (!out)
+    throw std::runtime_error("sparse_binary: impossibile creare " + path);
+  save_binary(out, m);
+  out.close();
+  if (!out)
+    throw std::runtime_error("sparse_binary: errore di scrittura " + path);
+}
+
+/**
+ * Legge una matrice nel formato binario copiandola in memoria, per gli
+ * stream o le piattaforme in cui la mappatura non e' disponibile.
+ *
+ * @param in stream di input (aperto in modalita' binaria)
+ * @param verify se true valida tutti gli indici, O(nnz)
+ *
+ * @return matrice CSR letta
+ *
+ * @throw std::runtime_error se il file non e' valido
+ * @throw eccezione di allocazione della memoria
+ */
+template <typename T, typename E>
+csr_matrix<T, E> load_binary(std::istream &in, bool verify = true)
+{
+  static_assert(std::is_trivially_copyable<T>::value,
+                "load_binary richiede un tipo copiabile byte per byte");
+
+  std::string bytes((std::istreambuf_iterator<char>(in)),
+                    std::istreambuf_iterator<char>());
+
+  // buffer allineato per qualunque tipo fondamentale
+  std::shared_ptr<std::vector<std::max_align_t> > image =
+      std::make_shared<std::vector<std::max_align_t> >(
+          (bytes.size() + sizeof(std::max_align_t) - 1) /
+          sizeof(std::max_align_t));
+  if (!bytes.empty())
+    std::memcpy(image->data(), bytes.data(), bytes.size());
+
+  return sparse_binary::from_image<T, E>(
+      reinterpret_cast<const char *>(image->data()), bytes.size(), image,
+      verify);
+}
+
+#ifdef SPARSE_BINARY_MMAP
+/**
+ * Mappa in memoria un file nel formato binario e ritorna una csr_matrix
+ * in sola lettura che ne usa direttamente le pagine, senza copie. Le
+ * pagine vengono caricate su richiesta e la mappatura e' condivisa, per
+ * cui piu' processi che mappano lo stesso file usano la stessa copia
+ * nella page cache. Il file resta mappato finche' esiste la matrice o
+ * una sua copia, e non deve essere modificato nel frattempo.
+ *
+ * Vengono sempre controllati, in O(1), l'intestazione (formato,
+ * versione, ordine dei byte, tipi), che ogni sezione sia allineata e
+ * contenuta nel file, e il primo e l'ultimo offset di riga. Con verify
+ * (il default) vengono controllati anche, in O(righe + nnz), che gli
+ * offset di riga siano crescenti e che gli indici di colonna siano
+ * crescenti nella riga e minori del numero di colonne: senza questo
+ * controllo un file corrotto causa letture fuori dagli array in
+ * operator(), negli iteratori di riga e in multiply(). verify = false
+ * va usato solo per file di cui ci si fida. I valori non vengono mai
+ * controllati.
+ *
+ * @param path percorso del file
+ * @param verify se true (default) valida offset e indici, O(righe + nnz)
+ *
+ * @return matrice CSR mappata
+ *
+ * @throw std::runtime_error se il file non puo' essere mappato o non e'
+ *        valido
+ */
+template <typename T, typename E>
+csr_matrix<T, E> map_binary(const std::string &path, bool verify = true)
+{
+  static_assert(std::is_trivially_copyable<T>::value,
+                "map_binary richiede un tipo copiabile byte per byte");
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("sparse_binary: impossibile aprire " + path);
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 ||
+      static_cast<std::uint64_t>(st.st_size) < sizeof(sparse_binary::file_header))
+  {
+    ::close(fd);
+    throw std::runtime_error("sparse_binary: file non valido " + path);
+  }
+
+  const std::size_t size = static_cast<std::size_t>(st.st_size);
+  void *p = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED)
+    throw std::runtime_error("sparse_binary: impossibile mappare " + path);
+
+  sparse_binary::unmapper deleter = {size};
+  std::shared_ptr<const void> owner(static_cast<const void *>(p), deleter);
+
+  return sparse_binary::from_image<T, E>(static_cast<const char *>(p), size,
+                                         owner, verify);
+}
+#endif
+
+#endif // BINARY_MATRIX_H
@@ -0,0 +1,344 @@
+#ifndef BSR_MATRIX_H
+#define BSR_MATRIX_H
+
+#include <cstddef>     // std::size_t
+#include <cstdint>     // std::uint64_t
+#include <memory>      // std::shared_ptr
+#include <algorithm>   // std::lower_bound, std::upper_bound, std::min
+#include <vector>      // std::vector
+#include <stdexcept>   // std::invalid_argument
+#include <type_traits> // std::is_arithmetic
+#include <utility>     // std::move
+#include "sparse_kernels.hpp"
+
+/**
+ * Classe che implementa una matrice sparsa immutabile a blocchi densi
+ * B x B (BSR, Block Sparse Row), ottenuta con sparse_matrix::freeze_bsr().
+ *
+ * La matrice e' divisa in blocchi B x B: vengono memorizzati solo i blocchi
+ * che contengono almeno un elemento, ciascuno come B * B valori contigui
+ * per righe (le celle del blocco senza elemento valgono il default).
+ * Il blocco-riga br occupa le posizioni [row_ptr[br], row_ptr[br + 1])
+ * degli indici di blocco-colonna (a 32 bit) e dei blocchi.
+ *
+ * Rispetto al formato per elementi si memorizza un indice per blocco
+ * anziche' due per valore, e il prodotto matrice-vettore, con B noto a
+ * tempo di compilazione, viene srotolato dal compilatore.
+ *
+ * @brief Matrice sparsa a blocchi in sola lettura
+ *
+ * @param T tipo del dato
+ * @param E funtore di comparazione (==) di due dati di tipo T
+ * @param B lato dei blocchi
+ */
+template <typename T, typename E, unsigned int B>
+class bsr_matrix
+{
+public:
+  static_assert(B > 0, "bsr_matrix richiede blocchi non vuoti");
+
+  typedef std::uint64_t offset_type; ///< tipo degli offset di blocco-riga
+  typedef unsigned int index_type;   ///< tipo degli indici di blocco-colonna
+
+  static const unsigned int block_size = B; ///< lato dei blocchi
+
+  /**
+   * Costruttore che acquisisce gli array BSR spostandoli, senza copie.
+   *
+   * @param rows numero di righe
+   * @param cols numero di colonne
+   * @param default_value valore di default della matrice
+   * @param row_ptr offset dei blocchi-riga, ceil(rows / B) + 1 elementi
+   * @param col_idx indici di blocco-colonna, row_ptr.back() elementi
+   * @param values valori dei blocchi, B * B * row_ptr.back() elementi
+   *
+   * @throw std::invalid_argument se le dimensioni degli array non sono
+   *        coerenti
+   * @throw eccezione di allocazione della memoria
+   */
+  bsr_matrix(unsigned int rows, unsigned int cols, const T &default_value,
+             std::vector<offset_type> &&row_ptr,
+             std::vector<index_type> &&col_idx, std::vector<T> &&values)
+      : _default(default_value), _nrows(rows), _ncols(cols)
+  {
+    if (row_ptr.size() != static_cast<std::size_t>(block_rows()) + 1 ||
+        col_idx.size() != row_ptr.back() ||
+        values.size() != row_ptr.back() * B * B)
+      throw std::invalid_argument("bsr_matrix: array BSR non coerenti");
+
+    std::shared_ptr<storage> data = std::make_shared<storage>();
+    data->row_ptr = std::move(row_ptr);
+    data->col_idx = std::move(col_idx);
+    data->values = std::move(values);
+
+    _row_ptr = data->row_ptr.data();
+    _col_idx = data->col_idx.data();
+    _values = data->values.data();
+    _owner = data;
+  }
+
+  /**
+   * Ritorna il numero di righe della matrice.
+   *
+   * @return numero di righe
+   */
+  unsigned int get_rows() const { return _nrows; }
+
+  /**
+   * Ritorna il numero di colonne della matrice.
+   *
+   * @return numero di colonne
+   */
+  unsigned int get_columns() const { return _ncols; }
+
+  /**
+   * Ritorna il numero di blocchi memorizzati.
+   *
+   * @return numero di blocchi
+   */
+  std::uint64_t get_blocks() const { return _row_ptr[block_rows()]; }
+
+  /**
+   * Ritorna il valore di default della matrice.
+   *
+   * @return valore di default
+   */
+  const T &get_default() const { return _default; }
+
+  /**
+   * Ritorna il numero di blocchi-riga, ceil(get_rows() / B).
+   *
+   * @return numero di blocchi-riga
+   */
+  unsigned int block_rows() const { return (_nrows + B - 1) / B; }
+
+  /**
+   * Ritorna il numero di blocchi-colonna, ceil(get_columns() / B).
+   *
+   * @return numero di blocchi-colonna
+   */
+  unsigned int block_columns() const { return (_ncols + B - 1) / B; }
+
+  /**
+   * Accesso diretto agli array BSR.
+   */
+  const offset_type *row_offsets() const { return _row_ptr; }
+  const index_type *column_indices() const { return _col_idx; }
+  const T *values() const { return _values; }
+
+  /**
+   * Operatore di lettura coordinate: ricerca binaria del blocco nel
+   * blocco-riga, O(log blocchi_riga).
+   *
+   * @param row indice di riga
+   * @param col indice di colonna
+   *
+   * @return valore dell'elemento corrispondente alle coordinate (row, col)
+   */
+  const T &operator()(const unsigned int row, const unsigned int col) const
+  {
+    if (row >= _nrows || col >= _ncols)
+      return _default;
+
+    const unsigned int br = row / B;
+    const index_type *first = _col_idx + _row_ptr[br];
+    const index_type *last = _col_idx + _row_ptr[br + 1];
+    const index_type *it = std::lower_bound(first, last, col / B);
+    if (it != last && *it == col / B)
+      return _values[(it - _col_idx) * B * B + (row % B) * B + col % B];
+    return _default;
+  }
+
+  /**
+   * Prodotto matrice-vettore y = M * x (SpMV), per T aritmetico.
+   *
+   * Come in sparse_matrix ogni riga vale d * sum(x) + sum (M(i, j) - d) *
+   * x[j]; le celle di default dei blocchi contribuiscono con zero.
+   *
+   * @param x vettore di get_columns() elementi
+   * @param y vettore di get_rows() elementi in cui scrivere il risultato
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  void multiply(const T *x, T *y) const
+  {
+    multiply(x, y, 1);
+  }
+
+  /**
+   * Prodotto matrice-vettore y = M * x (SpMV) eseguito in parallelo su
+   * blocchi-riga contigui con circa lo stesso numero di blocchi.
+   *
+   * @param x vettore di get_columns() elementi
+   * @param y vettore di get_rows() elementi in cui scrivere il risultato
+   * @param threads numero di thread da usare (0 = thread hardware)
+   *
+   * @throw eccezione di allocazione della memoria
+   * @throw std::system_error se non e' possibile creare un thread
+   */
+  void multiply(const T *x, T *y, unsigned int threads) const
+  {
+    static_assert(std::is_arithmetic<T>::value,
+                  "bsr_matrix::multiply richiede un tipo aritmetico");
+
+    // l'ultimo blocco-colonna puo' sporgere oltre x: copia con zeri in coda
+    std::vector<T> padded;
+    if (_ncols % B != 0)
+    {
+      padded.assign(x, x + _ncols);
+      padded.resize(static_cast<std::size_t>(block_columns()) * B, T());
+      x = padded.data();
+    }
+
+    std::vector<unsigned int> bounds = partition_rows(threads);
+    const T base = _default * kernels::sum(x, _ncols);
+
+    sparse_kernels::run_parallel(bounds.size() - 1, [&](unsigned int t) {
+      multiply_rows(x, y, base, bounds[t], bounds[t + 1]);
+    });
+  }
+
+  /**
+   * Prodotto matrice-vettore y = M * x (SpMV), per T aritmetico.
+   *
+   * @param x vettore di get_columns() elementi
+   * @param threads numero di thread da usare (0 = thread hardware)
+   *
+   * @return vettore di get_rows() elementi con il risultato
+   *
+   * @throw std::invalid_argument se x non ha get_columns() elementi
+   * @throw std::system_error se non e' possibile creare un thread
+   */
+  std::vector<T> multiply(const std::vector<T> &x,
+                          unsigned int threads = 1) const
+  {
+    if (x.size() != _ncols)
+      throw std::invalid_argument("bsr_matrix: dimensione di x errata");
+
+    std::vector<T> y(_nrows);
+    multiply(x.data(), y.data(), threads);
+    return y;
+  }
+
+private:
+  /**
+   * Array posseduti dalla matrice.
+   */
+  struct storage
+  {
+    std::vector<offset_type> row_ptr;
+    std::vector<index_type> col_idx;
+    std::vector<T> values;
+  };
+
+  typedef sparse_kernels::dispatch<T> kernels;
+
+  const offset_type *_row_ptr;  ///< offset dei blocchi-riga
+  const index_type *_col_idx;   ///< indici di blocco-colonna
+  const T *_values;             ///< valori dei blocchi, B * B per blocco
+  T _default;                   ///< valore di default
+  unsigned int _nrows;          ///< numero di righe
+  unsigned int _ncols;          ///< numero di colonne
+  std::shared_ptr<const void> _owner; ///< proprietario degli array
+
+  /**
+   * Funzione di supporto che calcola i blocchi-riga [br0, br1) del
+   * prodotto con x. I cicli su B hanno estremi costanti e vengono
+   * srotolati; le B somme parziali restano nei registri per tutto il
+   * blocco-riga.
+   */
+  void multiply_rows(const T *x, T *y, const T &base, unsigned int br0,
+                     unsigned int br1) const
+  {
+    const T d = _default;
+    for (unsigned int br = br0; br < br1; br++)
+    {
+      T acc[B];
+      for (unsigned int i = 0; i < B; i++)
+        acc[i] = T();
+
+      for (offset_type k = _row_ptr[br]; k < _row_ptr[br + 1]; k++)
+      {
+        const T *blk = _values + k * B * B;
+        const T *xb = x + static_cast<std::size_t>(_col_idx[k]) * B;
+        for (unsigned int i = 0; i < B; i++)
+          for (unsigned int j = 0; j < B; j++)
+            acc[i] += (blk[i * B + j] - d) * xb[j];
+      }
+
+      const unsigned int r0 = br * B;
+      const unsigned int n = std::min(B, _nrows - r0);
+      for (unsigned int i = 0; i < n; i++)
+        y[r0 + i] = base + acc[i];
+    }
+  }
+
+  /**
+   * Funzione di supporto che divide i blocchi-riga in al piu' threads
+   * intervalli contigui con circa lo stesso numero di blocchi.
+   */
+  std::vector<unsigned int> partition_rows(unsigned int threads) const
+  {
+    const unsigned int nbr = block_rows();
+    if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    if (threads > nbr)
+      threads = std::max(1u, nbr);
+
+    const offset_type nnzb = _row_ptr[nbr];
+    std::vector<unsigned int> bounds(1, 0);
+    for (unsigned int t = 1; t < threads; t++)
+    {
+      offset_type k = nnzb * t / threads;
+      unsigned int r = static_cast<unsigned int>(
+          std::upper_bound(_row_ptr, _row_ptr + nbr + 1, k) - _row_ptr - 1);
+      if (r > bounds.back())
+        bounds.push_back(r);
+    }
+    if (nbr > bounds.back() || bounds.size() == 1)
+      bounds.push_back(nbr);
+    return bounds;
+  }
+
+}; // END class bsr_matrix
+
+/**
+ * Funzione generica globale che data una matrice a blocchi M e un
+ * predicato P ritorna quanti valori in M (compresi i default) soddisfano P.
+ *
+ * @param M matrice sparsa a blocchi
+ * @param pred predicato da verificare
+ *
+ * @return numero di elementi di M che soddisfano P
+ */
+template <typename T, typename E, unsigned int B, typename P>
+std::uint64_t evaluate(const bsr_matrix<T, E, B> &M, P pred)
+{
+  std::uint64_t n = 0;
+  std::uint64_t stored = 0; // celle dei blocchi interne alla matrice
+  const T *values = M.values();
+  const typename bsr_matrix<T, E, B>::offset_type *row_ptr = M.row_offsets();
+  const typename bsr_matrix<T, E, B>::index_type *col_idx =
+      M.column_indices();
+
+  for (unsigned int br = 0; br < M.block_rows(); br++)
+  {
+    const unsigned int nr = std::min(B, M.get_rows() - br * B);
+    for (std::uint64_t k = row_ptr[br]; k < row_ptr[br + 1]; k++)
+    {
+      const unsigned int nc = std::min(B, M.get_columns() - col_idx[k] * B);
+      for (unsigned int i = 0; i < nr; i++)
+        for (unsigned int j = 0; j < nc; j++)
+          if (pred(values[k * B * B + i * B + j]))
+            n++;
+      stored += static_cast<std::uint64_t>(nr) * nc;
+    }
+  }
+
+  if (pred(M.get_default()))
+    n += static_cast<std::uint64_t>(M.get_rows()) * M.get_columns() - stored;
+
+  return n;
+}
+
+#endif // BSR_MATRIX_H
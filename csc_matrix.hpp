@@ -0,0 +1,277 @@
+#ifndef CSC_MATRIX_H
+#define CSC_MATRIX_H
+
+#include <iterator>    // std::forward_iterator_tag
+#include <cstddef>     // std::ptrdiff_t
+#include <cstdint>     // std::uint64_t
+#include <vector>      // std::vector
+#include <type_traits> // std::is_arithmetic
+#include "csr_matrix.hpp"
+
+/**
+ * Classe che implementa una matrice sparsa immutabile in formato CSC
+ * (Compressed Sparse Column), ottenuta con sparse_matrix::freeze_csc().
+ *
+ * Gli array CSC di una matrice coincidono con gli array CSR della sua
+ * trasposta, per cui la matrice e' memorizzata come csr_matrix della
+ * trasposta: l'accesso a una colonna e' O(1) e transpose() e' O(1).
+ *
+ * @brief Matrice sparsa in formato CSC in sola lettura
+ *
+ * @param T tipo del dato
+ * @param E funtore di comparazione (==) di due dati di tipo T
+ */
+template <typename T, typename E>
+class csc_matrix
+{
+public:
+  typedef typename csr_matrix<T, E>::offset_type offset_type;
+  typedef typename csr_matrix<T, E>::index_type index_type;
+  typedef typename csr_matrix<T, E>::const_element const_element;
+
+  /**
+   * Costruttore a partire dalla trasposta in formato CSR.
+   *
+   * @param transposed trasposta della matrice in formato CSR
+   */
+  explicit csc_matrix(const csr_matrix<T, E> &transposed)
+      : _t(transposed) {}
+
+  /**
+   * Ritorna il numero di righe della matrice.
+   *
+   * @return numero di righe
+   */
+  unsigned int get_rows() const { return _t.get_columns(); }
+
+  /**
+   * Ritorna il numero di colonne della matrice.
+   *
+   * @return numero di colonne
+   */
+  unsigned int get_columns() const { return _t.get_rows(); }
+
+  /**
+   * Ritorna il numero di elementi memorizzati.
+   *
+   * @return numero di elementi memorizzati
+   */
+  std::uint64_t get_size() const { return _t.get_size(); }
+
+  /**
+   * Ritorna il valore di default della matrice.
+   *
+   * @return valore di default
+   */
+  const T &get_default() const { return _t.get_default(); }
+
+  /**
+   * Ritorna il numero di elementi memorizzati nella colonna col, O(1).
+   *
+   * @param col indice di colonna (minore di get_columns())
+   * @return numero di elementi della colonna
+   */
+  std::uint64_t column_size(unsigned int col) const
+  {
+    return _t.row_size(col);
+  }
+
+  /**
+   * Accesso diretto agli array CSC.
+   */
+  const offset_type *column_offsets() const { return _t.row_offsets(); }
+  const index_type *row_indices() const { return _t.column_indices(); }
+  const T *values() const { return _t.values(); }
+
+  /**
+   * Operatore di lettura coordinate: ricerca binaria limitata alla
+   * colonna, O(log nnz_colonna).
+   *
+   * @param row indice di riga
+   * @param col indice di colonna
+   *
+   * @return valore dell'elemento corrispondente alle coordinate (row, col)
+   */
+  const T &operator()(const unsigned int row, const unsigned int col) const
+  {
+    return _t(col, row);
+  }
+
+  /**
+   * Ritorna la trasposta in formato CSR, in O(1) e senza copie.
+   *
+   * @return trasposta della matrice
+   */
+  const csr_matrix<T, E> &transpose() const { return _t; }
+
+  /**
+   * Iteratore costante della matrice: visita gli elementi memorizzati
+   * per colonna e, a parita' di colonna, per riga.
+   *
+   * @brief Iteratore costante per colonne della matrice
+   */
+  class const_iterator
+  {
+    /**
+     * Proxy restituito da operator->: conserva la vista sull'elemento
+     * corrente e ne espone l'indirizzo.
+     */
+    class arrow_proxy
+    {
+    public:
+      arrow_proxy(const const_element &e) : _e(e) {}
+
+      const const_element *operator->() const { return &_e; }
+
+    private:
+      const_element _e;
+    };
+
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef const_element value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef arrow_proxy pointer;
+    typedef const_element reference;
+
+    const_iterator() {}
+
+    // Ritorna il dato riferito dall'iteratore (derefenziamento)
+    reference operator*() const
+    {
+      const_element e = *_it;
+      return const_element(e.value, e.col, e.row);
+    }
+
+    // Ritorna il puntatore al dato riferito dall'iteratore
+    pointer operator->() const { return pointer(**this); }
+
+    // Operatore di iterazione post-incremento
+    const_iterator operator++(int)
+    {
+      const_iterator temp(*this);
+      ++(*this);
+      return temp;
+    }
+
+    // Operatore di iterazione pre-incremento
+    const_iterator &operator++()
+    {
+      ++_it;
+      return *this;
+    }
+
+    // Uguaglianza
+    bool operator==(const const_iterator &other) const
+    {
+      return _it == other._it;
+    }
+
+    // Diversita'
+    bool operator!=(const const_iterator &other) const
+    {
+      return _it != other._it;
+    }
+
+  private:
+    typename csr_matrix<T, E>::const_iterator _it; // posizione nella trasposta
+
+    // Classe container
+    friend class csc_matrix;
+
+    // Costruttore privato di inizializzazione usato dalla classe container
+    const_iterator(const typename csr_matrix<T, E>::const_iterator &it)
+        : _it(it) {}
+
+  }; // END class const_iterator
+
+  /**
+   * Ritorna l'iteratore al primo elemento della matrice.
+   *
+   * @return iteratore al primo elemento della matrice
+   */
+  const_iterator begin() const { return const_iterator(_t.begin()); }
+
+  /**
+   * Ritorna l'iteratore alla fine della matrice.
+   *
+   * @return iteratore alla fine della matrice
+   */
+  const_iterator end() const { return const_iterator(_t.end()); }
+
+  /**
+   * Ritorna l'iteratore al primo elemento della colonna col, O(1).
+   *
+   * @param col indice di colonna (minore di get_columns())
+   * @return iteratore al primo elemento della colonna
+   */
+  const_iterator column_begin(unsigned int col) const
+  {
+    return const_iterator(_t.row_begin(col));
+  }
+
+  /**
+   * Ritorna l'iteratore alla fine della colonna col, O(1).
+   *
+   * @param col indice di colonna (minore di get_columns())
+   * @return iteratore alla fine della colonna
+   */
+  const_iterator column_end(unsigned int col) const
+  {
+    return const_iterator(_t.row_end(col));
+  }
+
+  /**
+   * Prodotto con la trasposta y = M^T * x, per T aritmetico: ogni
+   * elemento di y e' il prodotto di una colonna contigua per x, con gli
+   * stessi kernel vettoriali di csr_matrix::multiply.
+   *
+   * @param x vettore di get_rows() elementi
+   * @param threads numero di thread da usare (0 = thread hardware)
+   *
+   * @return vettore di get_columns() elementi con il risultato
+   *
+   * @throw std::invalid_argument se x non ha get_rows() elementi
+   * @throw std::system_error se non e' possibile creare un thread
+   */
+  std::vector<T> multiply_transposed(const std::vector<T> &x,
+                                     unsigned int threads = 1) const
+  {
+    return _t.multiply(x, threads);
+  }
+
+  /**
+   * Somme per colonna, compresi i valori di default, per T aritmetico.
+   *
+   * @return vettore di get_columns() elementi con le somme delle colonne
+   */
+  std::vector<T> column_sums() const
+  {
+    static_assert(std::is_arithmetic<T>::value,
+                  "csc_matrix::column_sums richiede un tipo aritmetico");
+
+    std::vector<T> ones(get_rows(), T(1));
+    return _t.multiply(ones);
+  }
+
+private:
+  csr_matrix<T, E> _t; ///< trasposta della matrice in formato CSR
+
+}; // END class csc_matrix
+
+/**
+ * Funzione generica globale che data una matrice CSC M e un predicato P
+ * ritorna quanti valori in M (compresi i default) soddisfano P.
+ *
+ * @param M matrice sparsa in formato CSC
+ * @param pred predicato da verificare
+ *
+ * @return numero di elementi di M che soddisfano P
+ */
+template <typename T, typename E, typename P>
+std::uint64_t evaluate(const csc_matrix<T, E> &M, P pred)
+{
+  return evaluate(M.transpose(), pred);
+}
+
+#endif // CSC_MATRIX_H
@@ -0,0 +1,506 @@
+#ifndef CSR_MATRIX_H
+#define CSR_MATRIX_H
+
+#include <iterator>    // std::forward_iterator_tag
+#include <cstddef>     // std::ptrdiff_t, std::size_t
+#include <cstdint>     // std::uint64_t
+#include <memory>      // std::shared_ptr
+#include <algorithm>   // std::lower_bound, std::upper_bound
+#include <vector>      // std::vector
+#include <stdexcept>   // std::invalid_argument
+#include <type_traits> // std::is_arithmetic
+#include <utility>     // std::move
+#include "sparse_kernels.hpp"
+
+/**
+ * Classe che implementa una matrice sparsa immutabile in formato CSR
+ * (Compressed Sparse Row), ottenuta con sparse_matrix::freeze().
+ *
+ * Gli elementi della riga r occupano le posizioni [row_ptr[r], row_ptr[r+1])
+ * degli array degli indici di colonna (a 32 bit) e dei valori, ordinate per
+ * colonna. Rispetto a sparse_matrix non viene memorizzato l'indice di riga
+ * di ogni elemento e l'accesso a una riga e' O(1).
+ *
+ * Gli array sono riferiti tramite puntatori e mantenuti in vita da un
+ * oggetto proprietario condiviso: la copia di una csr_matrix e' O(1) e
+ * condivide gli stessi dati, che non possono essere modificati.
+ *
+ * @brief Matrice sparsa in formato CSR in sola lettura
+ *
+ * @param T tipo del dato
+ * @param E funtore di comparazione (==) di due dati di tipo T
+ */
+template <typename T, typename E>
+class csr_matrix
+{
+public:
+  typedef std::uint64_t offset_type; ///< tipo degli offset di riga
+  typedef unsigned int index_type;   ///< tipo degli indici di colonna
+
+  static_assert(sizeof(index_type) == 4,
+                "csr_matrix richiede indici di colonna a 32 bit");
+
+  /**
+   * Vista costante su un singolo elemento della matrice.
+   *
+   * @brief Elemento della matrice
+   */
+  struct const_element
+  {
+    const T &value;         ///< Dato memorizzato nella matrice
+    const unsigned int row; ///< Indice di riga dell'elemento
+    const unsigned int col; ///< Indice di colonna dell'elemento
+
+    /**
+     * Costruttore primario che inizializza un elemento costante.
+     *
+     * @param val reference al dato memorizzato nella matrice
+     * @param r indice di riga del dato
+     * @param c indice di colonna del dato
+     */
+    const_element(const T &val, const unsigned int &r, const unsigned int &c)
+        : value(val), row(r), col(c) {}
+
+  }; // END struct const_element
+
+  /**
+   * Costruttore di una matrice vuota.
+   *
+   * @param default_value valore di default della matrice
+   */
+  explicit csr_matrix(const T &default_value)
+      : _row_ptr(empty_offsets()), _col_idx(nullptr), _values(nullptr),
+        _default(default_value), _nrows(0), _ncols(0) {}
+
+  /**
+   * Costruttore che acquisisce gli array CSR spostandoli, senza copie.
+   *
+   * @param rows numero di righe
+   * @param cols numero di colonne
+   * @param default_value valore di default della matrice
+   * @param row_ptr offset di riga, rows + 1 elementi
+   * @param col_idx indici di colonna, row_ptr[rows] elementi
+   * @param values valori, row_ptr[rows] elementi
+   *
+   * @throw std::invalid_argument se le dimensioni degli array non sono
+   *        coerenti
+   * @throw eccezione di allocazione della memoria
+   */
+  csr_matrix(unsigned int rows, unsigned int cols, const T &default_value,
+             std::vector<offset_type> &&row_ptr,
+             std::vector<index_type> &&col_idx, std::vector<T> &&values)
+      : _default(default_value), _nrows(rows), _ncols(cols)
+  {
+    if (row_ptr.size() != static_cast<std::size_t>(rows) + 1 ||
+        col_idx.size() != row_ptr.back() || values.size() != row_ptr.back())
+      throw std::invalid_argument("csr_matrix: array CSR non coerenti");
+
+    std::shared_ptr<storage> data = std::make_shared<storage>();
+    data->row_ptr = std::move(row_ptr);
+    data->col_idx = std::move(col_idx);
+    data->values = std::move(values);
+
+    _row_ptr = data->row_ptr.data();
+    _col_idx = data->col_idx.data();
+    _values = data->values.data();
+    _owner = data;
+  }
+
+  /**
+   * Costruttore su array CSR gia' presenti in memoria (ad esempio mappati
+   * da file): la matrice non li copia e owner ne garantisce la validita'
+   * per tutta la vita della matrice e delle sue copie.
+   *
+   * @param rows numero di righe
+   * @param cols numero di colonne
+   * @param default_value valore di default della matrice
+   * @param row_ptr offset di riga, rows + 1 elementi
+   * @param col_idx indici di colonna, row_ptr[rows] elementi
+   * @param values valori, row_ptr[rows] elementi
+   * @param owner oggetto che mantiene in vita gli array
+   */
+  csr_matrix(unsigned int rows, unsigned int cols, const T &default_value,
+             const offset_type *row_ptr, const index_type *col_idx,
+             const T *values, const std::shared_ptr<const void> &owner)
+      : _row_ptr(row_ptr), _col_idx(col_idx), _values(values),
+        _default(default_value), _nrows(rows), _ncols(cols), _owner(owner) {}
+
+  /**
+   * Ritorna il numero di righe della matrice.
+   *
+   * @return numero di righe
+   */
+  unsigned int get_rows() const { return _nrows; }
+
+  /**
+   * Ritorna il numero di colonne della matrice.
+   *
+   * @return numero di colonne
+   */
+  unsigned int get_columns() const { return _ncols; }
+
+  /**
+   * Ritorna il numero di elementi memorizzati.
+   *
+   * @return numero di elementi memorizzati
+   */
+  std::uint64_t get_size() const { return _row_ptr[_nrows]; }
+
+  /**
+   * Ritorna il valore di default della matrice.
+   *
+   * @return valore di default
+   */
+  const T &get_default() const { return _default; }
+
+  /**
+   * Ritorna il numero di elementi memorizzati nella riga row, O(1).
+   *
+   * @param row indice di riga (minore di get_rows())
+   * @return numero di elementi della riga
+   */
+  std::uint64_t row_size(unsigned int row) const
+  {
+    return _row_ptr[row + 1] - _row_ptr[row];
+  }
+
+  /**
+   * Accesso diretto agli array CSR.
+   */
+  const offset_type *row_offsets() const { return _row_ptr; }
+  const index_type *column_indices() const { return _col_idx; }
+  const T *values() const { return _values; }
+
+  /**
+   * Operatore di lettura coordinate: ricerca binaria limitata alla riga,
+   * O(log nnz_riga).
+   *
+   * @param row indice di riga
+   * @param col indice di colonna
+   *
+   * @return valore dell'elemento corrispondente alle coordinate (row, col)
+   */
+  const T &operator()(const unsigned int row, const unsigned int col) const
+  {
+    if (row >= _nrows)
+      return _default;
+
+    const index_type *first = _col_idx + _row_ptr[row];
+    const index_type *last = _col_idx + _row_ptr[row + 1];
+    const index_type *it = std::lower_bound(first, last, col);
+    if (it != last && *it == col)
+      return _values[it - _col_idx];
+    return _default;
+  }
+
+  /**
+   * Iteratore costante della matrice: visita gli elementi memorizzati
+   * per riga e, a parita' di riga, per colonna.
+   *
+   * @brief Iteratore costante della matrice
+   */
+  class const_iterator
+  {
+    /**
+     * Proxy restituito da operator->: conserva la vista sull'elemento
+     * corrente e ne espone l'indirizzo.
+     */
+    class arrow_proxy
+    {
+    public:
+      arrow_proxy(const const_element &e) : _e(e) {}
+
+      const const_element *operator->() const { return &_e; }
+
+    private:
+      const_element _e;
+    };
+
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef const_element value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef arrow_proxy pointer;
+    typedef const_element reference;
+
+    const_iterator() : _m(nullptr), _k(0), _row(0) {}
+
+    // Ritorna il dato riferito dall'iteratore (derefenziamento)
+    reference operator*() const
+    {
+      return const_element(_m->_values[_k], _row, _m->_col_idx[_k]);
+    }
+
+    // Ritorna il puntatore al dato riferito dall'iteratore
+    pointer operator->() const { return pointer(**this); }
+
+    // Operatore di iterazione post-incremento
+    const_iterator operator++(int)
+    {
+      const_iterator temp(*this);
+      ++(*this);
+      return temp;
+    }
+
+    // Operatore di iterazione pre-incremento: salta le righe vuote
+    const_iterator &operator++()
+    {
+      ++_k;
+      while (_row < _m->_nrows && _k >= _m->_row_ptr[_row + 1])
+        ++_row;
+      return *this;
+    }
+
+    // Uguaglianza
+    bool operator==(const const_iterator &other) const
+    {
+      return _k == other._k;
+    }
+
+    // Diversita'
+    bool operator!=(const const_iterator &other) const
+    {
+      return _k != other._k;
+    }
+
+  private:
+    const csr_matrix *_m; // matrice visitata
+    offset_type _k;       // posizione corrente negli array
+    unsigned int _row;    // riga dell'elemento in posizione _k
+
+    // Classe container
+    friend class csr_matrix;
+
+    // Costruttore privato di inizializzazione usato dalla classe container
+    const_iterator(const csr_matrix *m, offset_type k, unsigned int row)
+        : _m(m), _k(k), _row(row) {}
+
+  }; // END class const_iterator
+
+  /**
+   * Ritorna l'iteratore al primo elemento della matrice.
+   *
+   * @return iteratore al primo elemento della matrice
+   */
+  const_iterator begin() const
+  {
+    unsigned int row = 0;
+    while (row < _nrows && _row_ptr[row + 1] == 0)
+      ++row;
+    return const_iterator(this, 0, row);
+  }
+
+  /**
+   * Ritorna l'iteratore alla fine della matrice.
+   *
+   * @return iteratore alla fine della matrice
+   */
+  const_iterator end() const
+  {
+    return const_iterator(this, _row_ptr[_nrows], _nrows);
+  }
+
+  /**
+   * Ritorna l'iteratore al primo elemento della riga row, O(1).
+   *
+   * @param row indice di riga (minore di get_rows())
+   * @return iteratore al primo elemento della riga
+   */
+  const_iterator row_begin(unsigned int row) const
+  {
+    return const_iterator(this, _row_ptr[row], row);
+  }
+
+  /**
+   * Ritorna l'iteratore alla fine della riga row, O(1).
+   *
+   * @param row indice di riga (minore di get_rows())
+   * @return iteratore alla fine della riga
+   */
+  const_iterator row_end(unsigned int row) const
+  {
+    return const_iterator(this, _row_ptr[row + 1], row);
+  }
+
+  /**
+   * Prodotto matrice-vettore y = M * x (SpMV), per T aritmetico.
+   * Usa gli stessi kernel vettoriali di sparse_matrix::multiply.
+   *
+   * @param x vettore di get_columns() elementi
+   * @param y vettore di get_rows() elementi in cui scrivere il risultato
+   */
+  void multiply(const T *x, T *y) const
+  {
+    static_assert(std::is_arithmetic<T>::value,
+                  "csr_matrix::multiply richiede un tipo aritmetico");
+
+    multiply_rows(x, y, _default * kernels::sum(x, _ncols), 0, _nrows,
+                  kernels::row_dot());
+  }
+
+  /**
+   * Prodotto matrice-vettore y = M * x (SpMV) eseguito in parallelo su
+   * blocchi di righe con circa lo stesso numero di elementi memorizzati.
+   *
+   * @param x vettore di get_columns() elementi
+   * @param y vettore di get_rows() elementi in cui scrivere il risultato
+   * @param threads numero di thread da usare (0 = thread hardware)
+   *
+   * @throw std::system_error se non e' possibile creare un thread
+   */
+  void multiply(const T *x, T *y, unsigned int threads) const
+  {
+    static_assert(std::is_arithmetic<T>::value,
+                  "csr_matrix::multiply richiede un tipo aritmetico");
+
+    std::vector<unsigned int> bounds = partition_rows(threads);
+    const T base = _default * kernels::sum(x, _ncols);
+    const typename kernels::row_dot_fn dot = kernels::row_dot();
+
+    sparse_kernels::run_parallel(bounds.size() - 1, [&](unsigned int t) {
+      multiply_rows(x, y, base, bounds[t], bounds[t + 1], dot);
+    });
+  }
+
+  /**
+   * Prodotto matrice-vettore y = M * x (SpMV), per T aritmetico.
+   *
+   * @param x vettore di get_columns() elementi
+   *
+   * @return vettore di get_rows() elementi con il risultato
+   *
+   * @throw std::invalid_argument se x non ha get_columns() elementi
+   */
+  std::vector<T> multiply(const std::vector<T> &x) const
+  {
+    if (x.size() != _ncols)
+      throw std::invalid_argument("csr_matrix: dimensione di x errata");
+
+    std::vector<T> y(_nrows);
+    multiply(x.data(), y.data());
+    return y;
+  }
+
+  /**
+   * Prodotto matrice-vettore y = M * x (SpMV) eseguito in parallelo.
+   *
+   * @param x vettore di get_columns() elementi
+   * @param threads numero di thread da usare (0 = thread hardware)
+   *
+   * @return vettore di get_rows() elementi con il risultato
+   *
+   * @throw std::invalid_argument se x non ha get_columns() elementi
+   * @throw std::system_error se non e' possibile creare un thread
+   */
+  std::vector<T> multiply(const std::vector<T> &x, unsigned int threads) const
+  {
+    if (x.size() != _ncols)
+      throw std::invalid_argument("csr_matrix: dimensione di x errata");
+
+    std::vector<T> y(_nrows);
+    multiply(x.data(), y.data(), threads);
+    return y;
+  }
+
+private:
+  /**
+   * Array posseduti dalla matrice quando costruita con freeze().
+   */
+  struct storage
+  {
+    std::vector<offset_type> row_ptr;
+    std::vector<index_type> col_idx;
+    std::vector<T> values;
+  };
+
+  typedef sparse_kernels::dispatch<T> kernels;
+
+  const offset_type *_row_ptr;  ///< offset di riga, _nrows + 1 elementi
+  const index_type *_col_idx;   ///< indici di colonna
+  const T *_values;             ///< valori
+  T _default;                   ///< valore di default
+  unsigned int _nrows;          ///< numero di righe
+  unsigned int _ncols;          ///< numero di colonne
+  std::shared_ptr<const void> _owner; ///< proprietario degli array
+
+  /**
+   * Funzione di supporto che ritorna gli offset di riga di una matrice
+   * senza righe, condivisi da tutte le matrici vuote.
+   */
+  static const offset_type *empty_offsets()
+  {
+    static const offset_type zero = 0;
+    return &zero;
+  }
+
+  /**
+   * Funzione di supporto che calcola le righe [r0, r1) del prodotto con x.
+   */
+  void multiply_rows(const T *x, T *y, const T &base, unsigned int r0,
+                     unsigned int r1, typename kernels::row_dot_fn dot) const
+  {
+    for (unsigned int r = r0; r < r1; r++)
+    {
+      offset_type first = _row_ptr[r];
+      y[r] = base + dot(_values + first, _col_idx + first,
+                        _row_ptr[r + 1] - first, x, _default);
+    }
+  }
+
+  /**
+   * Funzione di supporto che divide le righe in al piu' threads blocchi
+   * contigui con circa lo stesso numero di elementi memorizzati, cercando
+   * i confini direttamente negli offset di riga.
+   */
+  std::vector<unsigned int> partition_rows(unsigned int threads) const
+  {
+    if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    if (threads > _nrows)
+      threads = std::max(1u, _nrows);
+
+    const offset_type nnz = _row_ptr[_nrows];
+    std::vector<unsigned int> bounds(1, 0);
+    for (unsigned int t = 1; t < threads; t++)
+    {
+      offset_type k = nnz * t / threads;
+      unsigned int r = static_cast<unsigned int>(
+          std::upper_bound(_row_ptr, _row_ptr + _nrows + 1, k) - _row_ptr -
+          1);
+      if (r > bounds.back())
+        bounds.push_back(r);
+    }
+    if (_nrows > bounds.back() || bounds.size() == 1)
+      bounds.push_back(_nrows);
+    return bounds;
+  }
+
+}; // END class csr_matrix
+
+/**
+ * Funzione generica globale che data una matrice CSR M e un predicato P
+ * ritorna quanti valori in M (compresi i default) soddisfano P.
+ *
+ * @param M matrice sparsa in formato CSR
+ * @param pred predicato da verificare
+ *
+ * @return numero di elementi di M che soddisfano P
+ */
+template <typename T, typename E, typename P>
+std::uint64_t evaluate(const csr_matrix<T, E> &M, P pred)
+{
+  std::uint64_t n = 0;
+  const T *values = M.values();
+  const std::uint64_t size = M.get_size();
+
+  if (pred(M.get_default()))
+    n += static_cast<std::uint64_t>(M.get_rows()) * M.get_columns() - size;
+
+  for (std::uint64_t k = 0; k < size; k++)
+    if (pred(values[k]))
+      n++;
+
+  return n;
+}
+
+#endif // CSR_MATRIX_H
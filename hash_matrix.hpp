@@ -0,0 +1,533 @@
+#ifndef HASH_MATRIX_H
+#define HASH_MATRIX_H
+
+#include <iterator>  // std::forward_iterator_tag
+#include <cstddef>   // std::ptrdiff_t, std::size_t
+#include <cstdint>   // std::uint64_t
+#include <vector>    // std::vector
+#include <utility>   // std::swap
+#include <algorithm> // std::fill
+#include <memory>    // std::allocator, std::allocator_traits
+#include "sparse_matrix.hpp"
+
+/**
+ * Classe che implementa una matrice sparsa pensata per la costruzione con
+ * inserimenti in ordine casuale: gli elementi sono memorizzati in una
+ * tabella hash a indirizzamento aperto (scansione lineare) con chiave
+ * (riga, colonna), per cui add() e operator() costano O(1) in media,
+ * indipendentemente dall'ordine degli inserimenti.
+ *
+ * Gli elementi non sono ordinati: to_sparse() produce la sparse_matrix
+ * equivalente con un solo ordinamento radix, O(n).
+ *
+ * @brief Matrice sparsa a tabella hash per la costruzione
+ *
+ * @param T tipo del dato
+ * @param E funtore di comparazione (==) di due dati di tipo T
+ * @param A allocatore usato per i valori e (tramite rebind) per la tabella
+ * @param I tipo intero senza segno degli indici, come in sparse_matrix
+ */
+template <typename T, typename E, typename A = std::allocator<T>,
+          typename I = unsigned int>
+class hash_matrix
+{
+public:
+  typedef sparse_matrix<T, E, A, I> sparse_type; ///< matrice prodotta
+  typedef A allocator_type;                      ///< tipo dell'allocatore
+  typedef I index_type;                          ///< tipo degli indici
+
+  /**
+   * Vista costante su un singolo elemento della matrice.
+   *
+   * @brief Elemento della matrice
+   */
+  struct const_element
+  {
+    const T &value; ///< Dato inserito nella matrice
+    const I row;    ///< Indice di riga dell'elemento
+    const I col;    ///< Indice di colonna dell'elemento
+
+    /**
+     * Costruttore primario che inizializza un elemento costante.
+     *
+     * @param val reference al dato memorizzato nella matrice
+     * @param r indice di riga del dato
+     * @param c indice di colonna del dato
+     */
+    const_element(const T &val, const I &r, const I &c)
+        : value(val), row(r), col(c) {}
+
+  }; // END struct const_element
+
+  /**
+   * Costruttore primario.
+   *
+   * @param default_value valore di default della matrice
+   * @param expected numero di elementi previsto, per evitare riallocazioni
+   * @param alloc allocatore della tabella e della matrice prodotta
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  explicit hash_matrix(const T &default_value, std::size_t expected = 0,
+                       const A &alloc = A())
+      : _rows(index_allocator(alloc)), _cols(index_allocator(alloc)),
+        _values(alloc), _used(flag_allocator(alloc)), _default(default_value),
+        _size(0), _nrows(0), _ncols(0), _stale_shape(false), _alloc(alloc)
+  {
+    reserve(expected);
+  }
+
+  /**
+   * Ritorna il numero di elementi inseriti.
+   *
+   * @return numero di elementi inseriti
+   */
+  std::size_t get_size() const { return _size; }
+
+  /**
+   * Ritorna l'indice di riga massimo inserito piu' uno. Dopo la rimozione
+   * di un elemento sull'ultima riga o colonna le dimensioni vengono
+   * ricalcolate qui, alla prima richiesta, con una scansione della tabella.
+   *
+   * @return numero di righe
+   */
+  I get_rows() const
+  {
+    update_shape();
+    return _nrows;
+  }
+
+  /**
+   * Ritorna l'indice di colonna massimo inserito piu' uno (vedi
+   * get_rows()).
+   *
+   * @return numero di colonne
+   */
+  I get_columns() const
+  {
+    update_shape();
+    return _ncols;
+  }
+
+  /**
+   * Ritorna il valore di default della matrice.
+   *
+   * @return valore di default
+   */
+  const T &get_default() const { return _default; }
+
+  /**
+   * Ritorna l'allocatore della matrice.
+   *
+   * @return copia dell'allocatore
+   */
+  A get_allocator() const { return _alloc; }
+
+  /**
+   * Riserva spazio per almeno n elementi senza superare il fattore di
+   * carico massimo.
+   *
+   * @param n numero di elementi da riservare
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  void reserve(std::size_t n)
+  {
+    std::size_t cap = _used.empty() ? 16 : _used.size();
+    while (cap * max_load_num < n * max_load_den)
+      cap *= 2;
+    if (cap > _used.size())
+      rehash(cap);
+  }
+
+  /**
+   * Aggiunge o sovrascrive l'elemento (row, col), O(1) in media.
+   * Aggiungere il valore di default rimuove l'elemento, se presente.
+   *
+   * @param value valore da inserire
+   * @param row indice di riga
+   * @param col indice di colonna
+   *
+   * @throw std::out_of_range se row o col valgono
+   *        std::numeric_limits<I>::max() (vedi sparse_matrix::check_index)
+   * @throw eccezione di allocazione della memoria
+   */
+  void add(const T &value, const I row, const I col)
+  {
+    sparse_type::check_index(row, col);
+
+    std::size_t pos;
+    bool found = find(row, col, pos);
+
+    if (equals_(value, _default))
+    {
+      if (found)
+        erase_at(pos);
+      return;
+    }
+
+    if (found)
+    {
+      _values[pos] = value;
+      return;
+    }
+
+    if ((_size + 1) * max_load_den > _used.size() * max_load_num)
+    {
+      rehash(_used.size() * 2);
+      find(row, col, pos);
+    }
+
+    _rows[pos] = row;
+    _cols[pos] = col;
+    _values[pos] = value;
+    _used[pos] = 1;
+    _size++;
+
+    if (row >= _nrows)
+      _nrows = row + 1;
+    if (col >= _ncols)
+      _ncols = col + 1;
+  }
+
+  /**
+   * Operatore di lettura coordinate, O(1) in media.
+   *
+   * @param row indice di riga
+   * @param col indice di colonna
+   *
+   * @return valore dell'elemento corrispondente alle coordinate (row, col)
+   */
+  const T &operator()(const I row, const I col) const
+  {
+    std::size_t pos;
+    if (find(row, col, pos))
+      return _values[pos];
+    return _default;
+  }
+
+  /**
+   * Rimuove l'elemento (row, col), se presente, O(1) in media. Come in
+   * sparse_matrix, se l'elemento era sull'ultima riga o colonna le
+   * dimensioni si riducono a quelle degli elementi rimasti (il ricalcolo
+   * e' rimandato a get_rows() e get_columns()).
+   *
+   * @param row indice di riga
+   * @param col indice di colonna
+   *
+   * @return true se l'elemento era presente ed e' stato rimosso
+   */
+  bool erase(const I row, const I col)
+  {
+    std::size_t pos;
+    if (!find(row, col, pos))
+      return false;
+    erase_at(pos);
+    return true;
+  }
+
+  /**
+   * Cancella il contenuto della matrice, mantenendo la tabella allocata.
+   */
+  void clear()
+  {
+    std::fill(_used.begin(), _used.end(), 0);
+    std::fill(_values.begin(), _values.end(), _default);
+    _size = 0;
+    _nrows = 0;
+    _ncols = 0;
+    _stale_shape = false;
+  }
+
+  /**
+   * Iteratore costante della matrice: visita gli elementi nell'ordine
+   * della tabella, non per coordinate.
+   *
+   * @brief Iteratore costante della matrice
+   */
+  class const_iterator
+  {
+    /**
+     * Proxy restituito da operator->: conserva la vista sull'elemento
+     * corrente e ne espone l'indirizzo.
+     */
+    class arrow_proxy
+    {
+    public:
+      arrow_proxy(const const_element &e) : _e(e) {}
+
+      const const_element *operator->() const { return &_e; }
+
+    private:
+      const_element _e;
+    };
+
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef const_element value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef arrow_proxy pointer;
+    typedef const_element reference;
+
+    const_iterator() : _m(nullptr), _pos(0) {}
+
+    // Ritorna il dato riferito dall'iteratore (derefenziamento)
+    reference operator*() const
+    {
+      return const_element(_m->_values[_pos], _m->_rows[_pos],
+                           _m->_cols[_pos]);
+    }
+
+    // Ritorna il puntatore al dato riferito dall'iteratore
+    pointer operator->() const { return pointer(**this); }
+
+    // Operatore di iterazione post-incremento
+    const_iterator operator++(int)
+    {
+      const_iterator temp(*this);
+      ++(*this);
+      return temp;
+    }
+
+    // Operatore di iterazione pre-incremento: salta gli slot vuoti
+    const_iterator &operator++()
+    {
+      ++_pos;
+      skip();
+      return *this;
+    }
+
+    // Uguaglianza
+    bool operator==(const const_iterator &other) const
+    {
+      return _pos == other._pos;
+    }
+
+    // Diversita'
+    bool operator!=(const const_iterator &other) const
+    {
+      return _pos != other._pos;
+    }
+
+  private:
+    const hash_matrix *_m; // matrice visitata
+    std::size_t _pos;      // slot corrente della tabella
+
+    // Classe container
+    friend class hash_matrix;
+
+    // Costruttore privato di inizializzazione usato dalla classe container
+    const_iterator(const hash_matrix *m, std::size_t pos) : _m(m), _pos(pos)
+    {
+      skip();
+    }
+
+    void skip()
+    {
+      while (_pos < _m->_used.size() && !_m->_used[_pos])
+        ++_pos;
+    }
+
+  }; // END class const_iterator
+
+  /**
+   * Ritorna l'iteratore al primo elemento della matrice.
+   *
+   * @return iteratore al primo elemento della matrice
+   */
+  const_iterator begin() const { return const_iterator(this, 0); }
+
+  /**
+   * Ritorna l'iteratore alla fine della matrice.
+   *
+   * @return iteratore alla fine della matrice
+   */
+  const_iterator end() const { return const_iterator(this, _used.size()); }
+
+  /**
+   * Converte la matrice nel formato ordinato di sparse_matrix: gli
+   * elementi vengono accodati in una sola passata e ordinati una volta
+   * sola con l'ordinamento di from_triplets(), O(n) con indici fino a 32
+   * bit.
+   *
+   * @return sparse_matrix con gli stessi elementi, default e allocatore
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  sparse_type to_sparse() const
+  {
+    return sparse_type::from_triplets(begin(), end(), _default, merge_last(),
+                                      _alloc);
+  }
+
+private:
+  static const std::size_t max_load_num = 7;  ///< fattore di carico
+  static const std::size_t max_load_den = 10; ///< massimo: 7 / 10
+
+  typedef typename std::allocator_traits<A>::template rebind_alloc<I>
+      index_allocator;
+  typedef typename std::allocator_traits<A>::template rebind_alloc<
+      unsigned char>
+      flag_allocator;
+
+  std::vector<I, index_allocator> _rows;            ///< righe degli slot
+  std::vector<I, index_allocator> _cols;            ///< colonne degli slot
+  std::vector<T, A> _values;                        ///< valori degli slot
+  std::vector<unsigned char, flag_allocator> _used; ///< 1 se occupato
+  T _default;                                       ///< valore di default
+  std::size_t _size;         ///< numero di elementi inseriti
+  mutable I _nrows;          ///< indice di riga massimo + 1
+  mutable I _ncols;          ///< indice di colonna massimo + 1
+  mutable bool _stale_shape; ///< _nrows e _ncols da ricalcolare
+  E equals_;                 ///< oggetto funtore per l'uguaglianza
+  A _alloc;                  ///< allocatore della tabella
+
+  /**
+   * Funzione di supporto che ritorna lo slot ideale di (row, col): le
+   * due coordinate, fino a 64 bit, vengono combinate e mescolate.
+   */
+  std::size_t home(I row, I col) const
+  {
+    const std::uint64_t h =
+        mix(static_cast<std::uint64_t>(row) ^
+            mix(static_cast<std::uint64_t>(col) + 0x9e3779b97f4a7c15ULL));
+    return static_cast<std::size_t>(h) & (_used.size() - 1);
+  }
+
+  /**
+   * Funzione di supporto che mescola i bit della chiave (finalizzatore di
+   * splitmix64), cosi' che righe o colonne consecutive non finiscano in
+   * slot consecutivi.
+   */
+  static std::uint64_t mix(std::uint64_t k)
+  {
+    k ^= k >> 30;
+    k *= 0xbf58476d1ce4e5b9ULL;
+    k ^= k >> 27;
+    k *= 0x94d049bb133111ebULL;
+    k ^= k >> 31;
+    return k;
+  }
+
+  /**
+   * Funzione di supporto che cerca (row, col) nella tabella.
+   *
+   * @param row indice di riga
+   * @param col indice di colonna
+   * @param pos in uscita, lo slot dell'elemento oppure il primo slot
+   *            libero dove inserirlo
+   *
+   * @return true se l'elemento e' presente
+   */
+  bool find(I row, I col, std::size_t &pos) const
+  {
+    if (_used.empty())
+    {
+      pos = 0;
+      return false;
+    }
+
+    const std::size_t mask = _used.size() - 1;
+    pos = home(row, col);
+    while (_used[pos])
+    {
+      if (_rows[pos] == row && _cols[pos] == col)
+        return true;
+      pos = (pos + 1) & mask;
+    }
+    return false;
+  }
+
+  /**
+   * Funzione di supporto che rimuove l'elemento nello slot pos con lo
+   * spostamento all'indietro degli elementi successivi della stessa
+   * sequenza di scansione, senza lasciare marcatori di cancellazione.
+   */
+  void erase_at(std::size_t pos)
+  {
+    const std::size_t mask = _used.size() - 1;
+    if (_rows[pos] + 1 == _nrows || _cols[pos] + 1 == _ncols)
+      _stale_shape = true;
+    std::size_t next = (pos + 1) & mask;
+
+    while (_used[next])
+    {
+      std::size_t ideal = home(_rows[next], _cols[next]);
+      // l'elemento in next puo' occupare pos solo se pos e' tra la sua
+      // posizione ideale e next, in senso circolare
+      if (((next - ideal) & mask) >= ((next - pos) & mask))
+      {
+        _rows[pos] = _rows[next];
+        _cols[pos] = _cols[next];
+        std::swap(_values[pos], _values[next]);
+        pos = next;
+      }
+      next = (next + 1) & mask;
+    }
+
+    _used[pos] = 0;
+    _values[pos] = _default;
+    _size--;
+  }
+
+  /**
+   * Funzione di supporto che ricalcola le dimensioni sugli elementi
+   * rimasti, se un elemento sull'ultima riga o colonna e' stato rimosso
+   * dall'ultimo ricalcolo. Fino ad allora _nrows e _ncols sono solo un
+   * limite superiore, che add() puo' continuare ad aggiornare.
+   */
+  void update_shape() const
+  {
+    if (!_stale_shape)
+      return;
+    _stale_shape = false;
+    _nrows = 0;
+    _ncols = 0;
+    for (std::size_t i = 0; i < _used.size(); i++)
+    {
+      if (!_used[i])
+        continue;
+      if (_rows[i] >= _nrows)
+        _nrows = _rows[i] + 1;
+      if (_cols[i] >= _ncols)
+        _ncols = _cols[i] + 1;
+    }
+  }
+
+  /**
+   * Funzione di supporto che ridistribuisce gli elementi in una tabella
+   * di capacity slot (potenza di 2).
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  void rehash(std::size_t capacity)
+  {
+    std::vector<I, index_allocator> rows(capacity, I(0), _rows.get_allocator());
+    std::vector<I, index_allocator> cols(capacity, I(0), _cols.get_allocator());
+    std::vector<T, A> values(capacity, _default, _values.get_allocator());
+    std::vector<unsigned char, flag_allocator> used(capacity, 0,
+                                                    _used.get_allocator());
+
+    rows.swap(_rows);
+    cols.swap(_cols);
+    values.swap(_values);
+    used.swap(_used);
+
+    const std::size_t mask = capacity - 1;
+    for (std::size_t i = 0; i < used.size(); i++)
+    {
+      if (!used[i])
+        continue;
+      std::size_t pos = home(rows[i], cols[i]);
+      while (_used[pos])
+        pos = (pos + 1) & mask;
+      _rows[pos] = rows[i];
+      _cols[pos] = cols[i];
+      std::swap(_values[pos], values[i]);
+      _used[pos] = 1;
+    }
+  }
+
+}; // END class hash_matrix
+
+#endif // HASH_MATRIX_H
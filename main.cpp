@@ -1,7 +1,21 @@
 #include <cassert>
+#include <cmath>
+#include <functional>
 #include "sparse_matrix.hpp"
+#include "arena_allocator.hpp"
+#include "hash_matrix.hpp"
+#include "matrix_market.hpp"
+#include "binary_matrix.hpp"
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <fstream>
+#include <locale>
 #include <string>
 #include <vector>
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#endif
 
 /**
  * Funtore per l'uguaglianza tra tipi int
@@ -29,6 +43,19 @@ struct equals_long
   }
 };
 
+/**
+ * Funtore per l'uguaglianza tra tipi double
+ *
+ * @brief Funtore per l'uguaglianza tra tipi double
+ */
+struct equals_double
+{
+  bool operator()(const double &x, const double &y) const
+  {
+    return x == y;
+  }
+};
+
 /**
  * Funtore per l'uguaglianza tra stringhe
  *
@@ -271,7 +298,7 @@ struct equals_vector
  */
 std::ostream &operator<<(std::ostream &os, const std::vector<std::string> &vec)
 {
-  for (int i = 0; i < vec.size(); ++i)
+  for (std::size_t i = 0; i < vec.size(); ++i)
     os << vec[i] << " ";
 
   return os;
@@ -321,8 +348,8 @@ void test_vector()
   std::cout << "Stampa del contenuto con metodo operator(): "
             << std::endl;
 
-  for (int i = 0; i < sm_vec.get_rows(); i++)
-    for (int j = 0; j < sm_vec.get_columns(); j++)
+  for (unsigned int i = 0; i < sm_vec.get_rows(); i++)
+    for (unsigned int j = 0; j < sm_vec.get_columns(); j++)
       std::cout << "[" << i << ", " << j << "] = " << sm_vec(i, j) << std::endl;
 
   def_vector.clear();
@@ -572,6 +599,1795 @@ void test_voce()
             << std::endl;
 }
 
+void test_capacita()
+{
+  std::cout << std::endl
+            << "******************* TEST CAPACITA' *******************"
+            << std::endl;
+
+  sparse_matrix<int, equals_int> sm(0);
+
+  std::cout << "Riserva di 100 elementi e inserimento di 100 valori..."
+            << std::endl;
+
+  sm.reserve(100);
+  assert(sm.get_capacity() >= 100);
+  unsigned int cap = sm.get_capacity();
+
+  for (int i = 0; i < 100; i++)
+    sm.add(i + 1, i % 10, i / 10);
+
+  // nessuna riallocazione dopo reserve()
+  assert(sm.get_capacity() == cap);
+  assert(sm.get_size() == 100);
+
+  std::cout << "Inserimento di altri 50 valori senza reserve()..."
+            << std::endl;
+
+  for (int i = 0; i < 50; i++)
+    sm.add(i + 1, 10 + i, 0);
+
+  assert(sm.get_size() == 150);
+  assert(sm.get_capacity() >= 150);
+
+  sm.shrink_to_fit();
+  assert(sm.get_capacity() == sm.get_size());
+  assert(sm(3, 4) == 44);
+  assert(sm(59, 0) == 50);
+
+  std::cout << "Capacita' dopo shrink_to_fit(): " << sm.get_capacity()
+            << std::endl;
+
+  sm.clear();
+  assert(sm.get_capacity() == 0);
+
+  std::cout << "***************** END TEST CAPACITA' *****************"
+            << std::endl;
+}
+
+void test_ricerca()
+{
+  std::cout << std::endl
+            << "******************** TEST RICERCA ********************"
+            << std::endl;
+
+  sparse_matrix<int, equals_int> sm(-1);
+
+  std::cout << "Inserimento di una matrice 30 x 30 a scacchiera..."
+            << std::endl;
+
+  for (int i = 29; i >= 0; i--)
+    for (int j = 29; j >= 0; j--)
+      if ((i + j) % 2 == 0)
+        sm.add(i * 100 + j, i, j);
+
+  const sparse_matrix<int, equals_int> &csm = sm;
+
+  for (int i = 0; i < 30; i++)
+    for (int j = 0; j < 30; j++)
+      assert(csm(i, j) == ((i + j) % 2 == 0 ? i * 100 + j : -1));
+
+  std::cout << "Costruzione dell'indice di riga..." << std::endl;
+
+  sm.build_row_index();
+  assert(sm.has_row_index());
+
+  for (int i = 0; i < 32; i++)
+    for (int j = 0; j < 32; j++)
+      assert(sm(i, j) == ((i + j) % 2 == 0 && i < 30 && j < 30
+                              ? i * 100 + j
+                              : -1));
+
+  // la sovrascrittura di un valore esistente mantiene l'indice
+  sm.add(7, 2, 2);
+  assert(sm.has_row_index());
+  assert(sm(2, 2) == 7);
+
+  // un nuovo elemento invalida l'indice
+  sm.add(5, 0, 1);
+  assert(!sm.has_row_index());
+  assert(sm(0, 1) == 5);
+
+  std::cout << "****************** END TEST RICERCA ******************"
+            << std::endl;
+}
+
+void test_triplets()
+{
+  std::cout << std::endl
+            << "******************* TEST TRIPLETS ********************"
+            << std::endl;
+
+  typedef sparse_matrix<int, equals_int> matrix_int;
+  std::vector<matrix_int::triplet> t;
+
+  std::cout << "Costruzione in blocco da terne non ordinate con duplicati..."
+            << std::endl;
+
+  t.push_back(matrix_int::triplet(5, 3, 1));
+  t.push_back(matrix_int::triplet(1, 0, 2));
+  t.push_back(matrix_int::triplet(2, 3, 1));
+  t.push_back(matrix_int::triplet(0, 2, 2)); // uguale al default, scartato
+  t.push_back(matrix_int::triplet(7, 0, 0));
+  t.push_back(matrix_int::triplet(-2, 1, 1));
+  t.push_back(matrix_int::triplet(2, 1, 1)); // la somma e' il default
+
+  matrix_int last = matrix_int::from_triplets(t, 0);
+  assert(last.get_size() == 4);
+  assert(last(3, 1) == 2);
+  assert(last(1, 1) == 2);
+
+  std::cout << "Politica merge_last: " << std::endl
+            << last;
+
+  matrix_int sum = matrix_int::from_triplets(t.begin(), t.end(), 0,
+                                             merge_sum());
+  assert(sum.get_size() == 3);
+  assert(sum(3, 1) == 7);
+  assert(sum(1, 1) == 0);
+
+  std::cout << "Politica merge_sum: " << std::endl
+            << sum;
+
+  bool thrown = false;
+  try
+  {
+    matrix_int::from_triplets(t, 0, merge_error());
+  }
+  catch (const std::invalid_argument &)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // l'ordine risultante coincide con quello ottenuto tramite add()
+  matrix_int added(0);
+  for (int i = 0; i < 200; i++)
+    added.add(i + 1, (i * 37) % 23, (i * 11) % 17);
+
+  matrix_int bulk = matrix_int::from_triplets(added.begin(), added.end(), 0);
+  assert(bulk.get_size() == added.get_size());
+
+  matrix_int::const_iterator a = added.begin(), b = bulk.begin();
+  for (; a != added.end(); ++a, ++b)
+    assert(a->row == b->row && a->col == b->col && a->value == b->value);
+
+  std::cout << "***************** END TEST TRIPLETS ******************"
+            << std::endl;
+}
+
+/**
+ * Funtore che determina se un intero e' nullo.
+ *
+ * @brief Funtore per valutare se un intero e' zero
+ */
+struct is_zero
+{
+  bool operator()(const int &x) const
+  {
+    return x == 0;
+  }
+};
+
+void test_dimensioni()
+{
+  std::cout << std::endl
+            << "****************** TEST DIMENSIONI ******************"
+            << std::endl;
+
+  std::cout << "Creazione di una matrice 4 x 6 con dimensioni fisse..."
+            << std::endl;
+
+  sparse_matrix<int, equals_int> sm(4, 6, 0);
+  assert(sm.has_fixed_shape());
+  assert(sm.get_rows() == 4 && sm.get_columns() == 6);
+
+  sm.add(1, 0, 0);
+  sm.add(2, 3, 5);
+
+  bool thrown = false;
+  try
+  {
+    sm.add(3, 4, 0);
+  }
+  catch (const std::out_of_range &)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+  assert(sm.get_size() == 2);
+
+  // le celle di default sono contate sulle dimensioni dichiarate
+  is_zero zero;
+  assert(evaluate(sm, zero) == 22);
+
+  // le dimensioni dichiarate sopravvivono a copia e clear()
+  sparse_matrix<long, equals_long> sm_long(sm);
+  assert(sm_long.get_rows() == 4 && sm_long.get_columns() == 6);
+  sm.clear();
+  assert(sm.get_rows() == 4 && sm.get_columns() == 6);
+
+  std::cout << "Dimensioni dinamiche aggiornate ad ogni inserimento..."
+            << std::endl;
+
+  sparse_matrix<int, equals_int> dyn(0);
+  dyn.add(1, 2, 7);
+  assert(dyn.get_rows() == 3 && dyn.get_columns() == 8);
+  dyn.add(1, 5, 1);
+  assert(dyn.get_rows() == 6 && dyn.get_columns() == 8);
+  dyn.clear();
+  assert(dyn.get_rows() == 0 && dyn.get_columns() == 0);
+
+  std::cout << "**************** END TEST DIMENSIONI ****************"
+            << std::endl;
+}
+
+void test_spmv()
+{
+  std::cout << std::endl
+            << "********************* TEST SPMV *********************"
+            << std::endl;
+
+  std::cout << "Prodotto matrice-vettore con default 0 e default 2..."
+            << std::endl;
+
+  for (int def = 0; def <= 2; def += 2)
+  {
+    sparse_matrix<int, equals_int> sm(6, 5, def);
+    sm.add(1, 0, 0);
+    sm.add(4, 0, 3);
+    sm.add(-3, 2, 1);
+    sm.add(7, 4, 4);
+    sm.add(5, 4, 0);
+
+    std::vector<int> x;
+    for (int j = 0; j < 5; j++)
+      x.push_back(j + 1);
+
+    std::vector<int> y = sm.multiply(x);
+    assert(y.size() == 6);
+
+    for (int i = 0; i < 6; i++)
+    {
+      int expected = 0;
+      for (int j = 0; j < 5; j++)
+        expected += sm(i, j) * x[j];
+      assert(y[i] == expected);
+    }
+  }
+
+  std::cout << "Prodotto parallelo su una matrice con righe molto dense..."
+            << std::endl;
+
+  sparse_matrix<double, equals_double> power(0.5);
+  for (int i = 0; i < 300; i++)
+  {
+    // le righe multiple di 50 sono dense, le altre quasi vuote
+    int nnz = (i % 50 == 0) ? 200 : i % 3;
+    for (int j = 0; j < nnz; j++)
+      power.add(i + j * 0.25, i, (i * 7 + j * 13) % 211);
+  }
+
+  std::vector<double> x(power.get_columns());
+  for (unsigned int j = 0; j < x.size(); j++)
+    x[j] = 1.0 / (j + 1);
+
+  std::vector<double> serial = power.multiply(x);
+  for (unsigned int threads = 0; threads <= 8; threads++)
+  {
+    std::vector<double> parallel = power.multiply(x, threads);
+    assert(parallel == serial);
+  }
+
+  std::cout << "******************* END TEST SPMV *******************"
+            << std::endl;
+}
+
+/**
+ * Funtore per l'uguaglianza tra tipi float
+ *
+ * @brief Funtore per l'uguaglianza tra tipi float
+ */
+struct equals_float
+{
+  bool operator()(const float &x, const float &y) const
+  {
+    return x == y;
+  }
+};
+
+/**
+ * Verifica prodotto, somma e conteggi di una matrice di tipo T confrontandoli
+ * con il calcolo cella per cella, a meno della tolleranza tol.
+ */
+template <typename T, typename E>
+void check_kernels(const T &def, double tol)
+{
+  sparse_matrix<T, E> sm(def);
+
+  // righe di lunghezza 0..40 per coprire corpo vettoriale e resto scalare
+  for (int i = 0; i < 41; i++)
+    for (int j = 0; j < i; j++)
+      sm.add(static_cast<T>((i * 3 + j * 5) % 11 - 4), i, (i * 31 + j * 7) % 53);
+
+  std::vector<T> x(sm.get_columns());
+  for (unsigned int j = 0; j < x.size(); j++)
+    x[j] = static_cast<T>(j % 7) - 2;
+
+  std::vector<T> y = sm.multiply(x);
+  std::vector<T> yp = sm.multiply(x, 3);
+  T total = T();
+  std::uint64_t greater = 0;
+  std::uint64_t equal = 0;
+
+  for (unsigned int i = 0; i < sm.get_rows(); i++)
+  {
+    double expected = 0;
+    for (unsigned int j = 0; j < sm.get_columns(); j++)
+    {
+      expected += static_cast<double>(sm(i, j)) * x[j];
+      total += sm(i, j);
+      if (sm(i, j) > T(1))
+        greater++;
+      if (sm(i, j) == T(1))
+        equal++;
+    }
+    assert(std::abs(y[i] - expected) <= tol);
+    assert(y[i] == yp[i]);
+  }
+
+  assert(std::abs(static_cast<double>(sm.sum() - total)) <= tol);
+  assert(sm.count_if(std::greater<T>(), T(1)) == greater);
+  assert(sm.count_if(std::equal_to<T>(), T(1)) == equal);
+  assert(sm.count_if(std::less<T>(), T(1)) ==
+         static_cast<std::uint64_t>(sm.get_rows()) * sm.get_columns() -
+             greater - equal);
+}
+
+void test_simd()
+{
+  std::cout << std::endl
+            << "********************* TEST SIMD *********************"
+            << std::endl;
+
+  std::cout << "Kernel per double, float, int e long con default 0 e 3..."
+            << std::endl;
+
+  check_kernels<double, equals_double>(0.0, 1e-9);
+  check_kernels<double, equals_double>(3.0, 1e-9);
+  check_kernels<float, equals_float>(0.0f, 1e-3);
+  check_kernels<float, equals_float>(3.0f, 1e-3);
+  check_kernels<int, equals_int>(0, 0);
+  check_kernels<int, equals_int>(3, 0);
+  check_kernels<long, equals_long>(0, 0);
+  check_kernels<long, equals_long>(3, 0);
+
+  std::cout << "******************* END TEST SIMD *******************"
+            << std::endl;
+}
+
+void test_spgemm()
+{
+  std::cout << std::endl
+            << "******************** TEST SPGEMM ********************"
+            << std::endl;
+
+  std::cout << "Prodotto matrice-matrice confrontato con il prodotto denso..."
+            << std::endl;
+
+  int defaults[3][2] = {{0, 0}, {0, 2}, {1, -1}};
+
+  for (int d = 0; d < 3; d++)
+  {
+    sparse_matrix<long, equals_long> a(9, 7, defaults[d][0]);
+    sparse_matrix<long, equals_long> b(7, 8, defaults[d][1]);
+
+    for (int i = 0; i < 9; i++)
+      for (int k = 0; k < 7; k++)
+        if ((i * 3 + k) % 4 == 0)
+          a.add(i - k, i, k);
+
+    for (int k = 0; k < 7; k++)
+      for (int j = 0; j < 8; j++)
+        if ((k + j * 5) % 3 == 0)
+          b.add(k * j - 3, k, j);
+
+    for (unsigned int threads = 1; threads <= 4; threads++)
+    {
+      sparse_matrix<long, equals_long> c = a.multiply(b, threads);
+      assert(c.get_rows() == 9 && c.get_columns() == 8);
+      assert(c.get_default() == 7L * defaults[d][0] * defaults[d][1]);
+
+      for (int i = 0; i < 9; i++)
+        for (int j = 0; j < 8; j++)
+        {
+          long expected = 0;
+          for (int k = 0; k < 7; k++)
+            expected += a(i, k) * b(k, j);
+          assert(c(i, j) == expected);
+        }
+
+      // vengono memorizzati solo i valori diversi dal default
+      sparse_matrix<long, equals_long>::const_iterator it = c.begin();
+      for (; it != c.end(); ++it)
+        assert(it->value != c.get_default());
+    }
+  }
+
+  std::cout << "****************** END TEST SPGEMM ******************"
+            << std::endl;
+}
+
+/**
+ * Crea una matrice di interi con n elementi sulla diagonale, restituita
+ * per valore.
+ */
+sparse_matrix<int, equals_int> make_diagonal(int n)
+{
+  sparse_matrix<int, equals_int> sm(0);
+  for (int i = 0; i < n; i++)
+    sm.add(i + 1, i, i);
+  return sm;
+}
+
+void test_move()
+{
+  std::cout << std::endl
+            << "********************* TEST MOVE *********************"
+            << std::endl;
+
+  std::cout << "Costruzione e assegnamento per spostamento..." << std::endl;
+
+  sparse_matrix<int, equals_int> sm1 = make_diagonal(5);
+  assert(sm1.get_size() == 5 && sm1(4, 4) == 5);
+
+  sparse_matrix<int, equals_int> sm2(std::move(sm1));
+  assert(sm2.get_size() == 5 && sm2.get_rows() == 5);
+  assert(sm1.get_size() == 0 && sm1.get_rows() == 0);
+
+  sm1 = make_diagonal(3);
+  sm2 = std::move(sm1);
+  assert(sm2.get_size() == 3 && sm2(2, 2) == 3);
+
+  // il vettore sposta le matrici durante la riallocazione
+  std::vector<sparse_matrix<int, equals_int> > matrices;
+  for (int i = 1; i <= 10; i++)
+    matrices.push_back(make_diagonal(i));
+  for (int i = 1; i <= 10; i++)
+    assert(matrices[i - 1].get_size() == static_cast<unsigned int>(i));
+
+  std::cout << "Inserimento per spostamento ed emplace()..." << std::endl;
+
+  voce_rubrica default_v("null", "null", "null");
+  sparse_matrix<voce_rubrica, equals_voce> sm_voce(default_v);
+
+  voce_rubrica v("Mario", "Rossi", "0001");
+  sm_voce.add(std::move(v), 1, 1);
+  assert(v.nome.empty());
+  assert(sm_voce(1, 1).nome == "Mario");
+
+  sm_voce.emplace(0, 2, "Luigi", "Verdi", "0002");
+  assert(sm_voce.get_size() == 2);
+  assert(sm_voce(0, 2).ntel == "0002");
+
+  std::vector<std::string> words(3, "parola");
+  std::vector<std::string> def_vector(1, "<empty>");
+  sparse_matrix<std::vector<std::string>, equals_vector> sm_vec(def_vector);
+  sm_vec.add(std::move(words), 2, 0);
+  assert(words.empty());
+  assert(sm_vec(2, 0).size() == 3);
+
+  static_assert(std::is_nothrow_move_constructible<
+                    sparse_matrix<std::vector<std::string>, equals_vector> >::value,
+                "lo spostamento di una matrice non deve lanciare eccezioni");
+
+  std::cout << "******************* END TEST MOVE *******************"
+            << std::endl;
+}
+
+void test_copia()
+{
+  std::cout << std::endl
+            << "********************* TEST COPIA *********************"
+            << std::endl;
+
+  std::cout << "Copia e conversione di una matrice con 20000 elementi..."
+            << std::endl;
+
+  std::vector<sparse_matrix<double, equals_double>::triplet> t;
+  for (int i = 0; i < 20000; i++)
+    t.push_back(sparse_matrix<double, equals_double>::triplet(
+        (i % 10) * 0.5, (i * 7919) % 1000, (i * 104729) % 997));
+
+  sparse_matrix<double, equals_double> sm =
+      sparse_matrix<double, equals_double>::from_triplets(t, 0.0);
+
+  sparse_matrix<double, equals_double> copy(sm);
+  assert(copy.get_size() == sm.get_size());
+  assert(copy.get_capacity() == sm.get_size());
+  assert(copy.get_rows() == sm.get_rows());
+  assert(copy.get_columns() == sm.get_columns());
+
+  sparse_matrix<double, equals_double>::const_iterator a = sm.begin();
+  sparse_matrix<double, equals_double>::const_iterator b = copy.begin();
+  for (; a != sm.end(); ++a, ++b)
+    assert(a->row == b->row && a->col == b->col && a->value == b->value);
+
+  // i valori 0.5 diventano 0, il default, e vengono scartati
+  sparse_matrix<int, equals_int> converted(sm);
+  unsigned int halves = 0;
+  for (a = sm.begin(); a != sm.end(); ++a)
+  {
+    if (a->value == 0.5)
+      halves++;
+    assert(converted(a->row, a->col) == static_cast<int>(a->value));
+  }
+  assert(converted.get_size() == sm.get_size() - halves);
+
+  std::cout << "******************* END TEST COPIA *******************"
+            << std::endl;
+}
+
+/**
+ * Test dell'allocatore: matrici costruite su un'arena e, se disponibile,
+ * su una memory_resource polimorfa.
+ */
+void test_allocatore()
+{
+  std::cout << std::endl
+            << "****************** TEST ALLOCATORE *******************"
+            << std::endl;
+
+  typedef arena_allocator<double> alloc_type;
+  typedef sparse_matrix<double, equals_double, alloc_type> arena_matrix;
+
+  sparse_arena arena(1 << 12);
+  {
+    arena_matrix sm(0.0, alloc_type(arena));
+    for (unsigned int i = 0; i < 1000; i++)
+      sm.add(i + 1.0, (i * 7) % 100, i);
+    assert(sm.get_size() == 1000);
+    assert(sm(63, 9) == 10.0);
+    assert(arena.get_chunks() > 0);
+
+    // copia, conversione e prodotto condividono l'arena della sorgente
+    arena_matrix copy(sm);
+    assert(copy.get_allocator() == sm.get_allocator());
+    assert(copy(63, 9) == 10.0);
+
+    std::vector<arena_matrix::triplet> t;
+    t.push_back(arena_matrix::triplet(1.0, 2, 3));
+    t.push_back(arena_matrix::triplet(2.0, 2, 3));
+    arena_matrix built = arena_matrix::from_triplets(
+        t, 0.0, merge_sum(), alloc_type(arena));
+    assert(built(2, 3) == 3.0);
+
+    sparse_matrix<int, equals_int, arena_allocator<int> > converted(
+        sm, arena_allocator<int>(arena));
+    assert(converted(63, 9) == 10);
+
+    arena_matrix id(0.0, alloc_type(arena));
+    for (unsigned int i = 0; i < 1000; i++)
+      id.add(1.0, i, i);
+    arena_matrix prod = sm.multiply(id);
+    assert(prod.get_size() == sm.get_size());
+    assert(prod.get_allocator().arena() == &arena);
+
+    // clear non restituisce memoria all'arena: la matrice torna vuota
+    sm.clear();
+    assert(sm.get_size() == 0);
+    sm.add(4.0, 1, 1);
+    assert(sm(1, 1) == 4.0);
+
+    // anche l'indice di riga viene allocato nell'arena
+    sm.add(5.0, 2000, 1);
+    std::size_t chunks = arena.get_chunks();
+    sm.build_row_index();
+    assert(arena.get_chunks() == chunks + 1);
+    assert(sm.has_row_index() && sm(2000, 1) == 5.0);
+    sm.drop_row_index();
+  }
+  arena.release();
+  assert(arena.get_chunks() == 0);
+
+#if __cplusplus >= 201703L
+  std::pmr::monotonic_buffer_resource resource;
+  typedef std::pmr::polymorphic_allocator<double> pmr_alloc;
+  sparse_matrix<double, equals_double, pmr_alloc> pm(0.0, pmr_alloc(&resource));
+  pm.add(1.5, 3, 4);
+  assert(pm(3, 4) == 1.5);
+
+  // polymorphic_allocator non si propaga: ogni matrice resta sulla propria
+  // memory_resource e gli elementi vengono copiati o spostati
+  typedef sparse_matrix<double, equals_double, pmr_alloc> pmr_matrix;
+  std::pmr::monotonic_buffer_resource other_resource;
+  pmr_matrix a(0.0, pmr_alloc(&other_resource));
+  for (unsigned int i = 0; i < 50; i++)
+    a.add(i + 0.5, i, 2 * i);
+
+  pmr_matrix b(0.0, pmr_alloc(&resource));
+  b = a;
+  assert(b.get_allocator().resource() == &resource);
+  assert(b.get_size() == 50 && b(7, 14) == 7.5);
+
+  pmr_matrix c(0.0, pmr_alloc(&resource));
+  c.add(9.0, 1, 1);
+  c.swap(a);
+  assert(c.get_allocator().resource() == &resource);
+  assert(a.get_allocator().resource() == &other_resource);
+  assert(c.get_size() == 50 && c(7, 14) == 7.5);
+  assert(a.get_size() == 1 && a(1, 1) == 9.0);
+
+  pmr_matrix d(0.0, pmr_alloc(&other_resource));
+  d = std::move(c);
+  assert(d.get_allocator().resource() == &other_resource);
+  assert(d.get_size() == 50 && d(49, 98) == 49.5);
+  assert(c.get_size() == 0);
+
+  // stessa memory_resource: lo spostamento acquisisce gli array
+  pmr_matrix e(0.0, pmr_alloc(&other_resource));
+  e = std::move(d);
+  assert(e.get_size() == 50 && d.get_size() == 0);
+#endif
+
+  // arene diverse: arena_allocator non si propaga con lo spostamento
+  sparse_arena first_arena, second_arena;
+  {
+    arena_matrix x(0.0, alloc_type(first_arena));
+    arena_matrix y(0.0, alloc_type(second_arena));
+    x.add(2.0, 4, 5);
+    y = std::move(x);
+    assert(y.get_allocator().arena() == &second_arena);
+    assert(y(4, 5) == 2.0 && x.get_size() == 0);
+    y.swap(x);
+    assert(x.get_allocator().arena() == &first_arena);
+    assert(x(4, 5) == 2.0 && y.get_size() == 0);
+  }
+
+  std::cout << "**************** FINE TEST ALLOCATORE ****************"
+            << std::endl;
+}
+
+/**
+ * Test della rimozione di elementi: erase, erase_if, prune e add del
+ * valore di default.
+ */
+void test_rimozione()
+{
+  std::cout << std::endl
+            << "******************* TEST RIMOZIONE *******************"
+            << std::endl;
+
+  sparse_matrix<int, equals_int> sm(0);
+  for (unsigned int i = 0; i < 10; i++)
+    sm.add(i + 1, i, 2 * i);
+  assert(sm.get_size() == 10);
+  assert(sm.get_rows() == 10 && sm.get_columns() == 19);
+
+  // erase per coordinate
+  assert(sm.erase(3, 6));
+  assert(!sm.erase(3, 6));
+  assert(!sm.erase(3, 7));
+  assert(sm(3, 6) == 0);
+  assert(sm.get_size() == 9);
+
+  // rimuovere l'ultimo elemento riduce le dimensioni
+  assert(sm.erase(9, 18));
+  assert(sm.get_rows() == 9 && sm.get_columns() == 17);
+
+  // add del default su una cella occupata rimuove l'elemento
+  sm.add(0, 4, 8);
+  assert(sm.get_size() == 7);
+  assert(sm(4, 8) == 0);
+  sm.add(0, 4, 9);
+  assert(sm.get_size() == 7);
+
+  // erase tramite iteratore: rimozione dei valori pari durante la visita
+  sparse_matrix<int, equals_int>::iterator it = sm.begin();
+  while (it != sm.end())
+  {
+    if (it->value % 2 == 0)
+      it = sm.erase(it);
+    else
+      ++it;
+  }
+  assert(sm.get_size() == 4);
+  for (it = sm.begin(); it != sm.end(); ++it)
+    assert(it->value % 2 == 1);
+
+  // azzeramento tramite operator() e compattazione con prune
+  sm(0, 0) = 0;
+  sm(2, 4) = 0;
+  assert(sm.get_size() == 4);
+  assert(sm.prune() == 2);
+  assert(sm.get_size() == 2);
+  assert(sm(6, 12) == 7 && sm(8, 16) == 9);
+  assert(sm.get_rows() == 9 && sm.get_columns() == 17);
+
+  // erase_if e indice di riga
+  sm.build_row_index();
+  assert(sm.erase_if([](const int &x) { return x > 8; }) == 1);
+  assert(!sm.has_row_index());
+  assert(sm.get_size() == 1 && sm.get_rows() == 7 && sm.get_columns() == 13);
+
+  // le dimensioni fisse non cambiano
+  sparse_matrix<int, equals_int> fixed(5, 5, 0);
+  fixed.add(1, 4, 4);
+  fixed.erase(4, 4);
+  assert(fixed.get_size() == 0);
+  assert(fixed.get_rows() == 5 && fixed.get_columns() == 5);
+
+  std::cout << "**************** FINE TEST RIMOZIONE *****************"
+            << std::endl;
+}
+
+/**
+ * Test della rappresentazione CSR in sola lettura ottenuta con freeze().
+ */
+void test_csr()
+{
+  std::cout << std::endl
+            << "********************** TEST CSR **********************"
+            << std::endl;
+
+  sparse_matrix<double, equals_double> sm(0.5);
+  for (unsigned int i = 0; i < 40; i++)
+    for (unsigned int j = (i * 3) % 5; j < 30; j += 4 + i % 3)
+      sm.add(i * 100.0 + j, i, j);
+  sm.add(7.0, 45, 2); // righe 40..44 vuote
+
+  csr_matrix<double, equals_double> csr = sm.freeze();
+  assert(csr.get_rows() == sm.get_rows());
+  assert(csr.get_columns() == sm.get_columns());
+  assert(csr.get_size() == sm.get_size());
+  assert(csr.get_default() == 0.5);
+
+  // lettura per coordinate
+  for (unsigned int i = 0; i < sm.get_rows(); i++)
+    for (unsigned int j = 0; j < sm.get_columns(); j++)
+      assert(csr(i, j) == sm(i, j));
+  assert(csr(1000, 0) == 0.5);
+
+  // iterazione completa nello stesso ordine di sparse_matrix
+  sparse_matrix<double, equals_double>::const_iterator a = sm.begin();
+  csr_matrix<double, equals_double>::const_iterator b;
+  unsigned int n = 0;
+  for (b = csr.begin(); b != csr.end(); ++b, ++a, ++n)
+  {
+    assert(b->row == a->row && b->col == a->col);
+    assert(b->value == a->value);
+  }
+  assert(n == sm.get_size());
+
+  // iterazione per riga, O(1) per l'accesso alla riga
+  assert(csr.row_size(42) == 0);
+  assert(csr.row_begin(42) == csr.row_end(42));
+  for (unsigned int i = 0; i < csr.get_rows(); i++)
+  {
+    unsigned int cnt = 0;
+    for (b = csr.row_begin(i); b != csr.row_end(i); ++b, ++cnt)
+      assert(b->row == i && (*b).value == sm(i, b->col));
+    assert(cnt == csr.row_size(i));
+  }
+
+  // prodotto matrice-vettore e evaluate
+  std::vector<double> x(csr.get_columns());
+  for (unsigned int j = 0; j < x.size(); j++)
+    x[j] = 1.0 + j % 7;
+  std::vector<double> y1 = sm.multiply(x);
+  std::vector<double> y2 = csr.multiply(x);
+  std::vector<double> y3 = csr.multiply(x, 4);
+  for (unsigned int i = 0; i < y1.size(); i++)
+  {
+    assert(std::fabs(y1[i] - y2[i]) <= 1e-9 * std::fabs(y1[i]));
+    assert(y2[i] == y3[i]);
+  }
+
+  equals_double eq;
+  assert(evaluate(csr, [&](const double &v) { return eq(v, 0.5); }) ==
+         evaluate(sm, [&](const double &v) { return eq(v, 0.5); }));
+
+  // la copia condivide i dati e resta valida dopo la matrice di origine
+  csr_matrix<double, equals_double> copy(csr);
+  {
+    csr_matrix<double, equals_double> tmp = sm.freeze();
+    copy = tmp;
+  }
+  assert(copy(45, 2) == 7.0);
+
+  csr_matrix<double, equals_double> empty =
+      sparse_matrix<double, equals_double>(0.0).freeze();
+  assert(empty.get_size() == 0 && empty.begin() == empty.end());
+
+  std::cout << "******************* FINE TEST CSR ********************"
+            << std::endl;
+}
+
+/**
+ * Test della trasposta e della rappresentazione CSC per colonne.
+ */
+void test_trasposta()
+{
+  std::cout << std::endl
+            << "******************* TEST TRASPOSTA *******************"
+            << std::endl;
+
+  sparse_matrix<int, equals_int> sm(0);
+  for (unsigned int i = 0; i < 25; i++)
+    for (unsigned int j = i % 4; j < 18; j += 3 + i % 2)
+      sm.add(static_cast<int>(i * 100 + j) + 1, i, j);
+  sm.add(9, 30, 1);
+
+  // trasposta: dimensioni scambiate e ordine (riga, colonna) gia' valido
+  sparse_matrix<int, equals_int> t = sm.transpose();
+  assert(t.get_rows() == sm.get_columns());
+  assert(t.get_columns() == sm.get_rows());
+  assert(t.get_size() == sm.get_size());
+  for (unsigned int i = 0; i < sm.get_rows(); i++)
+    for (unsigned int j = 0; j < sm.get_columns(); j++)
+      assert(t(j, i) == sm(i, j));
+
+  sparse_matrix<int, equals_int>::const_iterator a, b;
+  sparse_matrix<int, equals_int> tt = t.transpose();
+  for (a = tt.begin(), b = sm.begin(); a != tt.end(); ++a, ++b)
+    assert(a->row == b->row && a->col == b->col && a->value == b->value);
+  assert(b == sm.end());
+
+  sparse_matrix<int, equals_int> fixed(3, 7, 0);
+  fixed.add(1, 2, 6);
+  sparse_matrix<int, equals_int> ft = fixed.transpose();
+  assert(ft.has_fixed_shape() && ft.get_rows() == 7 && ft.get_columns() == 3);
+  assert(ft(6, 2) == 1);
+
+  // CSC: accesso per colonne e prodotto con la trasposta
+  csc_matrix<int, equals_int> csc = sm.freeze_csc();
+  assert(csc.get_rows() == sm.get_rows());
+  assert(csc.get_columns() == sm.get_columns());
+  assert(csc.get_size() == sm.get_size());
+  for (unsigned int i = 0; i < sm.get_rows(); i++)
+    for (unsigned int j = 0; j < sm.get_columns(); j++)
+      assert(csc(i, j) == sm(i, j));
+
+  std::vector<int> sums(sm.get_columns(), 0);
+  for (a = sm.begin(); a != sm.end(); ++a)
+    sums[a->col] += a->value;
+  assert(csc.column_sums() == sums);
+
+  for (unsigned int j = 0; j < csc.get_columns(); j++)
+  {
+    unsigned int cnt = 0;
+    unsigned int last = 0;
+    csc_matrix<int, equals_int>::const_iterator c;
+    for (c = csc.column_begin(j); c != csc.column_end(j); ++c, ++cnt)
+    {
+      assert(c->col == j && c->value == sm(c->row, j));
+      assert(cnt == 0 || c->row > last);
+      last = c->row;
+    }
+    assert(cnt == csc.column_size(j));
+  }
+
+  std::vector<int> x(sm.get_rows());
+  for (unsigned int i = 0; i < x.size(); i++)
+    x[i] = static_cast<int>(i % 5) - 2;
+  assert(csc.multiply_transposed(x) == t.multiply(x));
+  assert(csc.multiply_transposed(x, 3) == t.multiply(x));
+  assert(evaluate(csc, is_zero()) == evaluate(sm, is_zero()));
+
+  std::cout << "**************** FINE TEST TRASPOSTA *****************"
+            << std::endl;
+}
+
+/**
+ * Confronta una matrice a blocchi B x B con la matrice da cui e' ottenuta.
+ */
+template <unsigned int B>
+void check_bsr(const sparse_matrix<double, equals_double> &sm)
+{
+  bsr_matrix<double, equals_double, B> bsr = sm.template freeze_bsr<B>();
+  assert(bsr.get_rows() == sm.get_rows());
+  assert(bsr.get_columns() == sm.get_columns());
+  for (unsigned int i = 0; i < sm.get_rows() + 2; i++)
+    for (unsigned int j = 0; j < sm.get_columns() + 2; j++)
+      assert(bsr(i, j) == sm(i, j));
+
+  std::vector<double> x(sm.get_columns());
+  for (unsigned int j = 0; j < x.size(); j++)
+    x[j] = 0.25 * (j % 9) - 1.0;
+  std::vector<double> y1 = sm.multiply(x);
+  std::vector<double> y2 = bsr.multiply(x);
+  std::vector<double> y3 = bsr.multiply(x, 3);
+  assert(y2.size() == y1.size());
+  for (unsigned int i = 0; i < y1.size(); i++)
+  {
+    assert(std::fabs(y1[i] - y2[i]) <= 1e-9 * (1.0 + std::fabs(y1[i])));
+    assert(y2[i] == y3[i]);
+  }
+
+  equals_double eq;
+  assert(evaluate(bsr, [&](const double &v) { return eq(v, 0.0); }) ==
+         evaluate(sm, [&](const double &v) { return eq(v, 0.0); }));
+  assert(evaluate(bsr, [&](const double &v) { return v > 3.0; }) ==
+         evaluate(sm, [&](const double &v) { return v > 3.0; }));
+}
+
+/**
+ * Test della rappresentazione a blocchi densi (BSR).
+ */
+void test_bsr()
+{
+  std::cout << std::endl
+            << "********************** TEST BSR **********************"
+            << std::endl;
+
+  // matrice a blocchi 3 x 3 densi, come da elementi finiti, con dimensioni
+  // non multiple del lato dei blocchi
+  const unsigned int nodes = 11;
+  sparse_matrix<double, equals_double> sm(3 * nodes - 1, 3 * nodes - 1, 0.0);
+  for (unsigned int a = 0; a < nodes; a++)
+    for (unsigned int b = 0; b < nodes; b++)
+    {
+      if (a != b && (a + 1 != b) && (b + 1 != a) && (a + b) % 5 != 0)
+        continue;
+      for (unsigned int i = 0; i < 3; i++)
+        for (unsigned int j = 0; j < 3; j++)
+          if (3 * a + i < sm.get_rows() && 3 * b + j < sm.get_columns())
+            sm.add(1.0 + a + 0.5 * b + 0.1 * i + 0.01 * j, 3 * a + i,
+                   3 * b + j);
+    }
+
+  bsr_matrix<double, equals_double, 3> bsr = sm.freeze_bsr<3>();
+  assert(bsr.block_rows() == nodes && bsr.block_columns() == nodes);
+  assert(bsr.get_blocks() * 9 >= sm.get_size());
+  assert(bsr.get_blocks() * 9 < sm.get_size() + 9 * nodes);
+
+  check_bsr<3>(sm);
+  check_bsr<4>(sm);
+  check_bsr<1>(sm);
+
+  // default non nullo
+  sparse_matrix<double, equals_double> sd(2.0);
+  sd.add(1.0, 0, 0);
+  sd.add(5.0, 6, 4);
+  sd.add(4.0, 2, 7);
+  check_bsr<3>(sd);
+  check_bsr<4>(sd);
+
+  std::cout << "******************* FINE TEST BSR ********************"
+            << std::endl;
+}
+
+/**
+ * Test della costruzione con tabella hash e inserimenti in ordine casuale.
+ */
+void test_hash()
+{
+  std::cout << std::endl
+            << "********************* TEST HASH **********************"
+            << std::endl;
+
+  hash_matrix<int, equals_int> hm(0);
+  std::vector<sparse_matrix<int, equals_int>::triplet> t;
+
+  // inserimenti in ordine pseudo-casuale, con sovrascritture
+  unsigned int seed = 12345;
+  for (unsigned int i = 0; i < 20000; i++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    unsigned int row = (seed >> 8) % 700;
+    seed = seed * 1103515245u + 12345u;
+    unsigned int col = (seed >> 8) % 900;
+    int value = static_cast<int>(i % 13) - 6;
+    hm.add(value, row, col);
+    t.push_back(sparse_matrix<int, equals_int>::triplet(value, row, col));
+  }
+
+  sparse_matrix<int, equals_int> expected =
+      sparse_matrix<int, equals_int>::from_triplets(t, 0);
+  assert(hm.get_size() == expected.get_size());
+
+  sparse_matrix<int, equals_int>::const_iterator it;
+  for (it = expected.begin(); it != expected.end(); ++it)
+    assert(hm(it->row, it->col) == it->value);
+
+  // conversione nel formato ordinato
+  sparse_matrix<int, equals_int> sm = hm.to_sparse();
+  sparse_matrix<int, equals_int>::const_iterator a = sm.begin();
+  for (it = expected.begin(); it != expected.end(); ++it, ++a)
+    assert(a->row == it->row && a->col == it->col && a->value == it->value);
+  assert(a == sm.end());
+
+  // rimozione, anche tramite il default, senza rompere le scansioni
+  unsigned int removed = 0;
+  for (it = expected.begin(); it != expected.end(); ++it)
+  {
+    if ((it->row + it->col) % 3 == 0)
+    {
+      if (it->col % 2 == 0)
+        assert(hm.erase(it->row, it->col));
+      else
+        hm.add(0, it->row, it->col);
+      removed++;
+    }
+  }
+  assert(hm.get_size() == expected.get_size() - removed);
+  for (it = expected.begin(); it != expected.end(); ++it)
+    assert(hm(it->row, it->col) ==
+           ((it->row + it->col) % 3 == 0 ? 0 : it->value));
+  assert(!hm.erase(5000, 5000));
+
+  unsigned int n = 0;
+  hash_matrix<int, equals_int>::const_iterator h;
+  for (h = hm.begin(); h != hm.end(); ++h, ++n)
+    assert(h->value != 0 && expected(h->row, h->col) == (*h).value);
+  assert(n == hm.get_size());
+
+  hm.clear();
+  assert(hm.get_size() == 0 && hm.begin() == hm.end());
+  assert(hm.to_sparse().get_size() == 0);
+
+  // le dimensioni si riducono alla rimozione come in sparse_matrix
+  hash_matrix<int, equals_int> shape(0);
+  sparse_matrix<int, equals_int> shape_ref(0);
+  const unsigned int cells[][2] = {{3, 9}, {7, 2}, {5, 5}};
+  for (unsigned int i = 0; i < 3; i++)
+  {
+    shape.add(1, cells[i][0], cells[i][1]);
+    shape_ref.add(1, cells[i][0], cells[i][1]);
+  }
+  shape.erase(7, 2);
+  shape_ref.erase(7, 2);
+  assert(shape.get_rows() == shape_ref.get_rows());
+  assert(shape.get_columns() == shape_ref.get_columns());
+  shape.add(0, 3, 9);
+  shape_ref.add(0, 3, 9);
+  assert(shape.get_rows() == 6 && shape.get_columns() == 6);
+  assert(shape_ref.get_rows() == 6 && shape_ref.get_columns() == 6);
+
+  // inserimenti dopo una rimozione sul bordo, prima di leggere le dimensioni
+  shape.add(1, 8, 8);
+  shape.erase(8, 8);
+  shape.add(1, 2, 7);
+  assert(shape.get_rows() == 6 && shape.get_columns() == 8);
+  assert(shape.erase(2, 7) && shape.get_columns() == 6);
+
+  // svuotamento dall'angolo in basso a destra
+  hash_matrix<int, equals_int> corner(0);
+  for (unsigned int i = 0; i < 500; i++)
+    corner.add(1, i, i);
+  for (unsigned int i = 500; i > 0; i--)
+  {
+    assert(corner.get_rows() == i && corner.get_columns() == i);
+    corner.erase(i - 1, i - 1);
+  }
+  assert(corner.get_rows() == 0 && corner.get_columns() == 0);
+
+  // l'indice massimo e' rifiutato subito, come in sparse_matrix
+  bool thrown = false;
+  try
+  {
+    shape.add(1, std::numeric_limits<unsigned int>::max(), 0);
+  }
+  catch (const std::out_of_range &)
+  {
+    thrown = true;
+  }
+  assert(thrown && shape.get_size() == 1);
+
+  // indici a 16 e 64 bit e allocatore personalizzato
+  hash_matrix<int, equals_int, std::allocator<int>, unsigned short> h16(0);
+  h16.add(4, 60000, 3);
+  sparse_matrix<int, equals_int, std::allocator<int>, unsigned short> s16 =
+      h16.to_sparse();
+  assert(s16.get_rows() == 60001 && s16(60000, 3) == 4);
+
+  hash_matrix<int, equals_int, std::allocator<int>, std::uint64_t> h64(0);
+  h64.add(5, 6000000000ULL, 1);
+  h64.add(6, 1, 6000000000ULL);
+  assert(h64(6000000000ULL, 1) == 5 && h64(1, 6000000000ULL) == 6);
+  assert(h64.to_sparse()(1, 6000000000ULL) == 6);
+
+  sparse_arena hash_arena;
+  hash_matrix<int, equals_int, arena_allocator<int> > ha(
+      0, 100, arena_allocator<int>(hash_arena));
+  for (unsigned int i = 0; i < 300; i++)
+    ha.add(static_cast<int>(i) + 1, i % 17, i);
+  sparse_matrix<int, equals_int, arena_allocator<int> > sa = ha.to_sparse();
+  assert(sa.get_allocator().arena() == &hash_arena);
+  assert(sa.get_size() == 300 && sa(16, 16) == 17);
+
+  std::cout << "******************* FINE TEST HASH *******************"
+            << std::endl;
+}
+
+/**
+ * Test degli indici di tipo configurabile: 16 bit per blocchi piccoli e
+ * 64 bit per dimensioni oltre 2^32.
+ */
+void test_indici()
+{
+  std::cout << std::endl
+            << "******************** TEST INDICI *********************"
+            << std::endl;
+
+  // indici a 16 bit
+  typedef sparse_matrix<int, equals_int, std::allocator<int>, std::uint16_t>
+      tile_matrix;
+  tile_matrix tile(0);
+  for (unsigned int i = 0; i < 200; i++)
+    tile.add(static_cast<int>(i) + 1, static_cast<std::uint16_t>(i * 37 % 300),
+             static_cast<std::uint16_t>(i * 11 % 250));
+  assert(tile.get_size() == 200);
+  assert(tile(37, 11) == 2);
+  std::vector<int> x(tile.get_columns(), 1);
+  std::vector<int> y = tile.multiply(x);
+  assert(y[37] == 2);
+  assert(tile.transpose()(11, 37) == 2);
+  assert(tile.freeze()(37, 11) == 2);
+
+  bool thrown = false;
+  try
+  {
+    tile.add(1, 65535, 0);
+  }
+  catch (const std::out_of_range &)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // indici a 64 bit, oltre 2^32
+  typedef sparse_matrix<double, equals_double, std::allocator<double>,
+                        std::uint64_t>
+      graph_matrix;
+  const std::uint64_t big = 6000000000ULL;
+  graph_matrix g(0.0);
+  g.add(1.0, big, 3);
+  g.add(2.0, 3, big);
+  g.add(3.0, big, big + 1);
+  g.add(4.0, 0, 0);
+  assert(g.get_rows() == big + 1 && g.get_columns() == big + 2);
+  assert(g(big, 3) == 1.0 && g(3, big) == 2.0 && g(big, big + 1) == 3.0);
+  assert(g(big & 0xFFFFFFFFULL, 3) == 0.0);
+
+  graph_matrix::const_iterator it = g.begin();
+  assert(it->row == 0);
+  ++it;
+  assert(it->row == 3 && it->col == big);
+
+  // costruzione in blocco con l'ordinamento per confronto
+  std::vector<graph_matrix::triplet> t;
+  t.push_back(graph_matrix::triplet(1.0, big, 5));
+  t.push_back(graph_matrix::triplet(2.0, 7, big));
+  t.push_back(graph_matrix::triplet(3.0, big, 5));
+  t.push_back(graph_matrix::triplet(4.0, 7, 1));
+  graph_matrix h = graph_matrix::from_triplets(t, 0.0, merge_sum());
+  assert(h.get_size() == 3 && h(big, 5) == 4.0 && h(7, big) == 2.0);
+  it = h.begin();
+  assert(it->row == 7 && it->col == 1);
+
+  graph_matrix ht = h.transpose();
+  assert(ht(5, big) == 4.0 && ht(big, 7) == 2.0);
+  assert(h.erase(big, 5) && h.get_rows() == 8);
+
+  std::cout << "****************** FINE TEST INDICI ******************"
+            << std::endl;
+}
+
+/**
+ * Test di evaluate parallelo e del conteggio a 64 bit.
+ */
+void test_evaluate()
+{
+  std::cout << std::endl
+            << "******************* TEST EVALUATE ********************"
+            << std::endl;
+
+  sparse_matrix<int, equals_int> sm(0);
+  for (unsigned int i = 0; i < 5000; i++)
+    sm.add(static_cast<int>(i % 17) - 8, i % 613, (i * 7) % 977);
+
+  is_zero zero;
+  std::uint64_t serial = evaluate(sm, zero);
+  assert(evaluate(sm, zero, 1) == serial);
+  assert(evaluate(sm, zero, 4) == serial);
+  assert(evaluate(sm, zero, 0) == serial);
+  assert(evaluate(sm, zero, 100000) == serial);
+
+  auto positive = [](const int &v) { return v > 0; };
+  std::uint64_t pos = 0;
+  sparse_matrix<int, equals_int>::const_iterator it;
+  for (it = sm.begin(); it != sm.end(); ++it)
+    if (it->value > 0)
+      pos++;
+  assert(evaluate(sm, positive, 3) == pos);
+  assert(sm.count_stored(positive, 5) == pos);
+
+  sparse_matrix<int, equals_int> empty(0);
+  assert(evaluate(empty, zero, 4) == 0);
+
+  // forma logica oltre 2^32 celle: il conteggio dei default non trabocca
+  sparse_matrix<int, equals_int> wide(100000, 100000, 0);
+  wide.add(1, 5, 5);
+  assert(evaluate(wide, zero) == 10000000000ULL - 1);
+  assert(evaluate(wide, zero, 2) == 10000000000ULL - 1);
+
+  std::cout << "***************** FINE TEST EVALUATE *****************"
+            << std::endl;
+}
+
+/**
+ * Punteggiatura numerica con separatore delle migliaia e virgola
+ * decimale, per verificare la lettura e la stampa con un locale diverso da
+ * quello classico.
+ */
+struct punteggiatura_it : std::numpunct<char>
+{
+protected:
+  char do_decimal_point() const { return ','; }
+  char do_thousands_sep() const { return '.'; }
+  std::string do_grouping() const { return "\3"; }
+};
+
+/**
+ * Test di lettura e scrittura nel formato Matrix Market.
+ */
+void test_matrix_market()
+{
+  std::cout << std::endl
+            << "***************** TEST MATRIX MARKET *****************"
+            << std::endl;
+
+  // andata e ritorno di una matrice generale, con piu' thread e blocchi
+  // piccoli per spezzare le righe tra un blocco e l'altro
+  sparse_matrix<double, equals_double> sm(0.0);
+  for (unsigned int i = 0; i < 2000; i++)
+    sm.add(0.1 * (i % 37) + 1.0 / 3.0, (i * 13) % 211, (i * 29) % 307);
+
+  std::stringstream ss;
+  write_matrix_market(ss, sm);
+  std::string text = ss.str();
+
+  for (unsigned int t = 1; t <= 4; t++)
+  {
+    std::istringstream in(text);
+    sparse_matrix<double, equals_double> rd =
+        read_matrix_market<double, equals_double>(in, 0.0, t, 64);
+    assert(rd.get_size() == sm.get_size());
+    assert(rd.get_rows() == sm.get_rows());
+    assert(rd.get_columns() == sm.get_columns());
+    sparse_matrix<double, equals_double>::const_iterator it;
+    for (it = sm.begin(); it != sm.end(); ++it)
+      assert(rd(it->row, it->col) == it->value);
+  }
+
+  // pattern simmetrico con commenti: le dimensioni dichiarate restano fisse
+  std::istringstream pattern("%%MatrixMarket matrix coordinate pattern "
+                             "symmetric\n"
+                             "% commento\n"
+                             "\n"
+                             "5 5 3\n"
+                             "1 1\n"
+                             "3 1\n"
+                             "4 2");
+  sparse_matrix<int, equals_int> p =
+      read_matrix_market<int, equals_int>(pattern, 0, 2);
+  assert(p.get_rows() == 5 && p.get_columns() == 5);
+  assert(p.get_size() == 5);
+  assert(p(0, 0) == 1 && p(2, 0) == 1 && p(0, 2) == 1);
+  assert(p(3, 1) == 1 && p(1, 3) == 1 && p(4, 4) == 0);
+
+  // antisimmetrica intera
+  std::istringstream skew("%%MatrixMarket matrix coordinate integer "
+                          "skew-symmetric\n"
+                          "3 3 2\n"
+                          "2 1 4\n"
+                          "3 2 -7\n");
+  sparse_matrix<int, equals_int> k =
+      read_matrix_market<int, equals_int>(skew, 0);
+  assert(k(1, 0) == 4 && k(0, 1) == -4);
+  assert(k(2, 1) == -7 && k(1, 2) == 7);
+
+  // scrittura simmetrica: solo il triangolo inferiore
+  sparse_matrix<int, equals_int> s(0);
+  s.add(2, 0, 0);
+  s.add(5, 1, 0);
+  s.add(5, 0, 1);
+  std::stringstream sout;
+  write_matrix_market(sout, s, true);
+  std::istringstream sin(sout.str());
+  sparse_matrix<int, equals_int> s2 =
+      read_matrix_market<int, equals_int>(sin, 0);
+  assert(s2.get_size() == 3 && s2(0, 1) == 5 && s2(1, 0) == 5);
+
+  // letture indipendenti dal locale globale
+  std::locale previous = std::locale::global(
+      std::locale(std::locale::classic(), new punteggiatura_it));
+  std::istringstream comma("%%MatrixMarket matrix coordinate real general\n"
+                           "2000 2 2\n"
+                           "1500 1 1.5\n"
+                           "2 2 +2.5e-1\n");
+  sparse_matrix<double, equals_double> cm =
+      read_matrix_market<double, equals_double>(comma, 0.0);
+  std::locale::global(previous);
+  assert(cm.get_rows() == 2000 && cm(1499, 0) == 1.5 && cm(1, 1) == 0.25);
+
+  // interi agli estremi del tipo
+  std::istringstream limits("%%MatrixMarket matrix coordinate integer "
+                            "general\n"
+                            "2 2 2\n"
+                            "1 1 -2147483648\n"
+                            "2 2 2147483647\n");
+  sparse_matrix<int, equals_int> lm =
+      read_matrix_market<int, equals_int>(limits, 0);
+  assert(lm(0, 0) == std::numeric_limits<int>::min());
+  assert(lm(1, 1) == std::numeric_limits<int>::max());
+
+  // valori reali o fuori dai limiti non vengono letti in un tipo intero
+  const char *bad_int[] = {
+      "%%MatrixMarket matrix coordinate real general\n2 2 1\n1 1 2.7\n",
+      "%%MatrixMarket matrix coordinate real general\n2 2 1\n1 1 0.4\n",
+      "%%MatrixMarket matrix coordinate integer general\n2 2 1\n"
+      "1 1 2147483648\n",
+      "%%MatrixMarket matrix coordinate integer general\n2 2 1\n"
+      "1 1 -2147483649\n"};
+  for (unsigned int i = 0; i < sizeof(bad_int) / sizeof(bad_int[0]); i++)
+  {
+    std::istringstream in(bad_int[i]);
+    bool thrown = false;
+    try
+    {
+      read_matrix_market<int, equals_int>(in, 0);
+    }
+    catch (const std::runtime_error &)
+    {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  // file non validi
+  const char *bad[] = {
+      "%%MatrixMarket matrix array real general\n2 2\n1\n2\n3\n4\n",
+      "%%MatrixMarket matrix coordinate complex general\n1 1 1\n1 1 1 0\n",
+      "%%MatrixMarket matrix coordinate real general\n2 2 1\n3 1 1.0\n",
+      "%%MatrixMarket matrix coordinate real general\n2 2 2\n1 1 1.0\n",
+      "%%MatrixMarket matrix coordinate real general\n2 2 1\n1 1\n"};
+  for (unsigned int i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+  {
+    std::istringstream in(bad[i]);
+    bool thrown = false;
+    try
+    {
+      read_matrix_market<double, equals_double>(in, 0.0);
+    }
+    catch (const std::runtime_error &)
+    {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  std::cout << "************** FINE TEST MATRIX MARKET ***************"
+            << std::endl;
+}
+
+/**
+ * Test del formato binario e della mappatura in memoria.
+ */
+void test_binario()
+{
+  std::cout << std::endl
+            << "******************** TEST BINARIO ********************"
+            << std::endl;
+
+  sparse_matrix<double, equals_double> sm(-1.5);
+  for (unsigned int i = 0; i < 3000; i++)
+    sm.add(0.25 * i, (i * 17) % 401, (i * 31) % 89);
+  sm.add(2.0, 599, 3); // righe finali vuote comprese nelle dimensioni
+
+  // andata e ritorno in memoria
+  std::stringstream ss;
+  save_binary(ss, sm);
+  csr_matrix<double, equals_double> ld =
+      load_binary<double, equals_double>(ss);
+  assert(ld.get_rows() == sm.get_rows());
+  assert(ld.get_columns() == sm.get_columns());
+  assert(ld.get_size() == sm.get_size());
+  assert(ld.get_default() == -1.5);
+  for (unsigned int r = 0; r < sm.get_rows(); r++)
+    for (unsigned int c = 0; c < sm.get_columns(); c++)
+      assert(ld(r, c) == sm(r, c));
+
+  // tipo diverso e file troncato vengono rifiutati
+  std::string image = ss.str();
+  bool thrown = false;
+  try
+  {
+    std::istringstream in(image);
+    load_binary<float, equals_float>(in);
+  }
+  catch (const std::runtime_error &)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+
+  thrown = false;
+  try
+  {
+    std::istringstream in(image.substr(0, image.size() - 8));
+    load_binary<double, equals_double>(in);
+  }
+  catch (const std::runtime_error &)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+
+#ifdef SPARSE_BINARY_MMAP
+  const char *path = "test_binario.spmx";
+  save_binary(path, sm);
+  {
+    csr_matrix<double, equals_double> mp =
+        map_binary<double, equals_double>(path);
+    csr_matrix<double, equals_double> copy = mp; // condivide la mappatura
+    assert(copy.get_size() == sm.get_size());
+    assert(copy(599, 3) == 2.0 && copy(598, 3) == -1.5);
+
+    std::vector<double> x(sm.get_columns(), 1.0);
+    std::vector<double> expected = sm.freeze().multiply(x);
+    assert(mp.multiply(x, 2) == expected);
+  }
+
+  // offset di riga non crescenti: rifiutati dal controllo di default
+  sparse_binary::file_header header;
+  std::memcpy(&header, image.data(), sizeof(header));
+  std::string corrupt = image;
+  std::uint64_t bad_offset = header.nnz + 1000;
+  std::memcpy(&corrupt[header.row_ptr_pos + 5 * sizeof(std::uint64_t)],
+              &bad_offset, sizeof(bad_offset));
+  {
+    std::ofstream out(path, std::ios::binary);
+    out.write(corrupt.data(), static_cast<std::streamsize>(corrupt.size()));
+  }
+  thrown = false;
+  try
+  {
+    map_binary<double, equals_double>(path);
+  }
+  catch (const std::runtime_error &)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // indice di colonna fuori dalla matrice
+  corrupt = image;
+  unsigned int bad_col = sm.get_columns();
+  std::memcpy(&corrupt[header.col_idx_pos], &bad_col, sizeof(bad_col));
+  {
+    std::ofstream out(path, std::ios::binary);
+    out.write(corrupt.data(), static_cast<std::streamsize>(corrupt.size()));
+  }
+  thrown = false;
+  try
+  {
+    map_binary<double, equals_double>(path);
+  }
+  catch (const std::runtime_error &)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // senza verifica il file viene mappato cosi' com'e'
+  assert((map_binary<double, equals_double>(path, false).get_size() ==
+          sm.get_size()));
+  std::remove(path);
+#endif
+
+  sparse_matrix<int, equals_int> empty(7);
+  std::stringstream es;
+  save_binary(es, empty);
+  csr_matrix<int, equals_int> le = load_binary<int, equals_int>(es);
+  assert(le.get_size() == 0 && le.get_default() == 7);
+
+  std::cout << "***************** FINE TEST BINARIO ******************"
+            << std::endl;
+}
+
+/**
+ * Test della stampa bufferizzata: confronto con la stampa cella per cella
+ * tramite operator(), finestre e formati CSV/TSV.
+ */
+void test_stampa()
+{
+  std::cout << std::endl
+            << "******************** TEST STAMPA *********************"
+            << std::endl;
+
+  sparse_matrix<double, equals_double> sm(0.5);
+  for (unsigned int i = 0; i < 200; i++)
+    sm.add(1.0 / (i + 1) - 3.0 * (i % 3), (i * 7) % 23, (i * 11) % 19);
+
+  // show() coincide con la stampa cella per cella di operator()
+  std::ostringstream fast, slow;
+  sm.show(fast);
+  for (unsigned int i = 0; i < sm.get_rows(); i++)
+  {
+    slow << std::endl;
+    for (unsigned int j = 0; j < sm.get_columns(); j++)
+      slow << sm(i, j) << " | ";
+  }
+  slow << std::endl;
+  assert(fast.str() == slow.str());
+
+  // operator<< coincide con la stampa elemento per elemento, anche con
+  // una precisione diversa da quella di default
+  for (int prec = 3; prec <= 17; prec += 14)
+  {
+    std::ostringstream a, b;
+    a.precision(prec);
+    b.precision(prec);
+    a << sm;
+    sparse_matrix<double, equals_double>::const_iterator it;
+    for (it = sm.begin(); it != sm.end(); ++it)
+      b << "[" << it->row << ", " << it->col << "] = " << it->value << '\n';
+    assert(a.str() == b.str());
+  }
+
+  // formati dello stream diversi da quello di default vengono rispettati
+  std::ostringstream fixed_a, fixed_b;
+  fixed_a << std::fixed;
+  fixed_b << std::fixed;
+  fixed_a << sm;
+  sparse_matrix<double, equals_double>::const_iterator it = sm.begin();
+  fixed_b << "[" << it->row << ", " << it->col << "] = " << it->value << '\n';
+  assert(fixed_a.str().compare(0, fixed_b.str().size(), fixed_b.str()) == 0);
+
+  // con un locale diverso da quello classico la stampa resta quella di
+  // operator<<
+  sparse_matrix<double, equals_double> big(0.0);
+  big.add(1234567.0, 0, 0);
+  big.add(0.25, 1, 1);
+  big.add(-98765.5, 1, 2);
+  sparse_matrix<int, equals_int> big_int(0);
+  big_int.add(1234567, 2, 3);
+
+  std::locale it_locale(std::locale::classic(), new punteggiatura_it);
+  std::ostringstream loc_a, loc_b, loc_c, loc_d;
+  loc_a.imbue(it_locale);
+  loc_b.imbue(it_locale);
+  loc_c.imbue(it_locale);
+  loc_d.imbue(it_locale);
+  loc_a << big << big_int;
+  sparse_matrix<double, equals_double>::const_iterator bi;
+  for (bi = big.begin(); bi != big.end(); ++bi)
+    loc_b << "[" << bi->row << ", " << bi->col << "] = " << bi->value
+          << '\n';
+  loc_b << "[" << 2u << ", " << 3u << "] = " << 1234567 << '\n';
+  assert(loc_a.str() == loc_b.str());
+  assert(loc_a.str().find("1.234.567") != std::string::npos);
+  assert(loc_a.str().find("0,25") != std::string::npos);
+
+  big.show(loc_c);
+  for (unsigned int i = 0; i < big.get_rows(); i++)
+  {
+    loc_d << std::endl;
+    for (unsigned int j = 0; j < big.get_columns(); j++)
+      loc_d << big(i, j) << " | ";
+  }
+  loc_d << std::endl;
+  assert(loc_c.str() == loc_d.str());
+
+  // finestra in CSV e TSV
+  sparse_matrix<int, equals_int> si(0);
+  si.add(1, 0, 0);
+  si.add(2, 1, 2);
+  si.add(-3, 2, 1);
+  si.add(4, 3, 3);
+
+  std::ostringstream csv, tsv, grid, outside;
+  si.show(csv, sparse_format::print_options(sparse_format::csv));
+  assert(csv.str() == "1,0,0,0\n0,0,2,0\n0,-3,0,0\n0,0,0,4\n");
+  si.show(tsv, sparse_format::print_options(1, 2, 1, 2, sparse_format::tsv));
+  assert(tsv.str() == "0\t2\n-3\t0\n");
+  si.show(grid, sparse_format::print_options(2, 100, 3, 100));
+  assert(grid.str() == "\n0 | \n4 | \n");
+  si.show(outside, sparse_format::print_options(10, 1, 0, 4,
+                                                sparse_format::csv));
+  assert(outside.str().empty());
+
+  // tipi non numerici passano per operator<< del tipo
+  sparse_matrix<std::string, equals_str> ss("-");
+  ss.add("ab", 0, 1);
+  std::ostringstream sout;
+  ss.show(sout, sparse_format::print_options(sparse_format::csv));
+  assert(sout.str() == "-,ab\n");
+
+  std::cout << "****************** FINE TEST STAMPA ******************"
+            << std::endl;
+}
+
+/**
+ * Test delle viste senza copie su righe e blocchi.
+ */
+void test_viste()
+{
+  std::cout << std::endl
+            << "********************* TEST VISTE *********************"
+            << std::endl;
+
+  typedef sparse_view<int, equals_int, std::allocator<int>, unsigned int>
+      view;
+
+  sparse_matrix<int, equals_int> sm(40, 30, 0);
+  for (unsigned int i = 0; i < 400; i++)
+    sm.add(static_cast<int>(i % 9) - 4, (i * 7) % 40, (i * 13) % 30);
+
+  // confronto con il filtro di tutti gli elementi
+  const unsigned int boxes[][4] = {
+      {0, 0, 40, 30}, {5, 3, 17, 11}, {0, 29, 40, 30}, {39, 0, 40, 30},
+      {10, 10, 10, 20}, {12, 4, 13, 4}, {3, 0, 9, 30}};
+  for (unsigned int b = 0; b < sizeof(boxes) / sizeof(boxes[0]); b++)
+  {
+    const unsigned int r0 = boxes[b][0], c0 = boxes[b][1];
+    const unsigned int r1 = boxes[b][2], c1 = boxes[b][3];
+    view v = sm.block(r0, c0, r1, c1);
+    assert(v.get_rows() == r1 - r0 && v.get_columns() == c1 - c0);
+
+    std::vector<sparse_matrix<int, equals_int>::triplet> expected;
+    sparse_matrix<int, equals_int>::const_iterator it;
+    for (it = sm.begin(); it != sm.end(); ++it)
+      if (it->row >= r0 && it->row < r1 && it->col >= c0 && it->col < c1)
+        expected.push_back(sparse_matrix<int, equals_int>::triplet(
+            it->value, it->row - r0, it->col - c0));
+
+    std::size_t k = 0;
+    view::const_iterator vi;
+    for (vi = v.begin(); vi != v.end(); vi++, k++)
+    {
+      assert(k < expected.size());
+      assert(vi->row == expected[k].row && vi->col == expected[k].col);
+      assert(vi->value == expected[k].value);
+      assert(v(vi->row, vi->col) == vi->value);
+    }
+    assert(k == expected.size() && v.get_size() == k);
+
+    is_zero zero;
+    std::uint64_t zeros = 0;
+    for (unsigned int r = r0; r < r1; r++)
+      for (unsigned int c = c0; c < c1; c++)
+        if (sm(r, c) == 0)
+          zeros++;
+    assert(evaluate(v, zero) == zeros);
+  }
+
+  // righe e riga singola
+  assert(sm.rows(0, 40).get_size() == sm.get_size());
+  assert(evaluate(sm.rows(0, 40), is_zero()) == evaluate(sm, is_zero()));
+  view r7 = sm.row(7);
+  assert(r7.get_rows() == 1 && r7.first_row() == 7);
+  for (unsigned int c = 0; c < 30; c++)
+    assert(r7(0, c) == sm(7, c));
+
+  bool thrown = false;
+  try
+  {
+    sm.block(0, 0, 41, 30);
+  }
+  catch (const std::out_of_range &)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // con l'indice di riga le ricerche usano gli offset di riga
+  std::size_t before = sm.block(5, 3, 17, 11).get_size();
+  sm.build_row_index();
+  assert(sm.block(5, 3, 17, 11).get_size() == before);
+  assert(sm.rows(39, 40).get_size() == sm.row(39).get_size());
+
+  std::cout << "****************** FINE TEST VISTE *******************"
+            << std::endl;
+}
+
+/**
+ * Test degli iteratori ad accesso casuale e degli iteratori di riga.
+ */
+void test_iteratori()
+{
+  std::cout << std::endl
+            << "******************* TEST ITERATORI *******************"
+            << std::endl;
+
+  typedef sparse_matrix<int, equals_int> matrix;
+  matrix sm(0);
+  for (unsigned int i = 0; i < 500; i++)
+    sm.add(static_cast<int>(i) + 1, (i * 7) % 50, (i * 11) % 37);
+
+  const matrix &csm = sm;
+  matrix::const_iterator first = csm.begin(), last = csm.end();
+
+  // distanza e avanzamento in O(1)
+  assert(std::distance(first, last) ==
+         static_cast<std::ptrdiff_t>(sm.get_size()));
+  assert(last - first == static_cast<std::ptrdiff_t>(sm.get_size()));
+  matrix::const_iterator mid = first + 100;
+  assert(mid - first == 100 && (mid - 100) == first);
+  assert(first < mid && mid <= mid && last > mid && mid >= first);
+  assert(first[100].value == mid->value && (2 + first)->row == first[2].row);
+
+  // il pre-incremento avanza
+  matrix::const_iterator step = first;
+  ++step;
+  assert(step - first == 1);
+  --step;
+  assert(step == first);
+
+  // visita all'indietro con std::reverse_iterator
+  std::size_t back = 0;
+  std::reverse_iterator<matrix::const_iterator> rit(last), rend(first);
+  for (matrix::const_iterator fwd = last; rit != rend; ++rit, ++back)
+  {
+    --fwd;
+    assert(rit->row == fwd->row && rit->col == fwd->col);
+  }
+  assert(back == sm.get_size());
+
+  // ricerca binaria con gli algoritmi della libreria standard
+  auto before = [](const matrix::const_element &e,
+                   const std::pair<unsigned int, unsigned int> &key) {
+    return e.row < key.first || (e.row == key.first && e.col < key.second);
+  };
+  for (unsigned int r = 0; r < 50; r += 7)
+    for (unsigned int c = 0; c < 37; c += 5)
+    {
+      matrix::const_iterator it = std::lower_bound(
+          first, last, std::make_pair(r, c), before);
+      if (it != last && it->row == r && it->col == c)
+        assert(it->value == sm(r, c));
+      else
+        assert(sm(r, c) == 0);
+    }
+
+  // iteratori di riga: coppie (colonna, valore) di una sola riga
+  std::size_t total = 0;
+  for (unsigned int r = 0; r < sm.get_rows() + 2; r++)
+  {
+    matrix::const_iterator b = csm.row_begin(r), e = csm.row_end(r);
+    int previous = -1;
+    for (matrix::const_iterator it = b; it != e; ++it)
+    {
+      assert(it->row == r && static_cast<int>(it->col) > previous);
+      assert(it->value == sm(r, it->col));
+      previous = static_cast<int>(it->col);
+    }
+    total += static_cast<std::size_t>(e - b);
+  }
+  assert(total == sm.get_size());
+
+  // iteratori modificabili di riga, anche con l'indice di riga
+  sm.build_row_index();
+  for (matrix::iterator it = sm.row_begin(7); it != sm.row_end(7); it++)
+    it->value = -it->value;
+  for (unsigned int c = 0; c < 37; c++)
+    assert(sm(7, c) <= 0);
+  matrix::iterator w = sm.begin();
+  w += 3;
+  assert(w[-3].value == sm.begin()->value && sm.end() - w ==
+         static_cast<std::ptrdiff_t>(sm.get_size()) - 3);
+
+  sparse_matrix<int, equals_int, std::allocator<int>, unsigned char> tiny(0);
+  tiny.add(1, 254, 3);
+  assert(tiny.row_end(255) == tiny.end());
+  assert(tiny.row_end(254) - tiny.row_begin(254) == 1);
+
+  std::cout << "**************** FINE TEST ITERATORI *****************"
+            << std::endl;
+}
+
 int main(int argc, char const *argv[])
 {
   test_metodi_fondamentali();
@@ -580,6 +2396,28 @@ int main(int argc, char const *argv[])
   test_vector();
   test_point();
   test_voce();
+  test_capacita();
+  test_ricerca();
+  test_triplets();
+  test_dimensioni();
+  test_spmv();
+  test_simd();
+  test_spgemm();
+  test_move();
+  test_copia();
+  test_allocatore();
+  test_rimozione();
+  test_csr();
+  test_trasposta();
+  test_bsr();
+  test_hash();
+  test_indici();
+  test_evaluate();
+  test_matrix_market();
+  test_binario();
+  test_stampa();
+  test_viste();
+  test_iteratori();
 
   return 0;
 }
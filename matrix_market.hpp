@@ -0,0 +1,512 @@
+#ifndef MATRIX_MARKET_H
+#define MATRIX_MARKET_H
+
+#include <istream>     // std::istream
+#include <ostream>     // std::ostream
+#include <fstream>     // std::ifstream, std::ofstream
+#include <sstream>     // std::istringstream
+#include <string>      // std::string, std::getline
+#include <vector>      // std::vector
+#include <cstdint>     // std::uint64_t, std::int64_t
+#include <cctype>      // std::tolower
+#include <limits>      // std::numeric_limits
+#include <locale>      // std::locale, std::num_get
+#include <algorithm>   // std::max, std::copy
+#include <thread>      // std::thread::hardware_concurrency
+#include <stdexcept>   // std::runtime_error
+#include <type_traits> // std::is_integral, std::is_floating_point
+#if __cplusplus >= 201703L
+#include <charconv>    // std::from_chars
+#endif
+#include "sparse_matrix.hpp"
+
+/**
+ * Funzioni di supporto per la lettura e la scrittura di matrici nel
+ * formato Matrix Market coordinato (.mtx).
+ */
+namespace matrix_market
+{
+
+/**
+ * Intestazione di un file Matrix Market coordinato.
+ */
+struct header
+{
+  bool pattern;        ///< valori assenti: ogni elemento vale 1
+  bool integer;        ///< valori interi
+  bool symmetric;      ///< memorizzato solo il triangolo inferiore
+  bool skew;           ///< antisimmetrica: a(j, i) = -a(i, j)
+  std::uint64_t rows;  ///< numero di righe
+  std::uint64_t cols;  ///< numero di colonne
+  std::uint64_t nnz;   ///< numero di righe di dati nel file
+};
+
+inline std::string lower(std::string s)
+{
+  for (std::size_t i = 0; i < s.size(); i++)
+    s[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(s[i])));
+  return s;
+}
+
+/**
+ * Legge la riga di intestazione, i commenti e la riga delle dimensioni.
+ *
+ * @throw std::runtime_error se l'intestazione non e' valida o non
+ *        supportata
+ */
+inline header read_header(std::istream &in)
+{
+  std::string line;
+  if (!std::getline(in, line))
+    throw std::runtime_error("matrix_market: file vuoto");
+
+  std::istringstream banner(line);
+  std::string magic, object, format, field, symmetry;
+  banner >> magic >> object >> format >> field >> symmetry;
+  object = lower(object);
+  format = lower(format);
+  field = lower(field);
+  symmetry = lower(symmetry);
+
+  if (magic != "%%MatrixMarket" || object != "matrix")
+    throw std::runtime_error("matrix_market: intestazione non valida");
+  if (format != "coordinate")
+    throw std::runtime_error("matrix_market: supportato solo coordinate");
+
+  header h;
+  h.pattern = field == "pattern";
+  h.integer = field == "integer";
+  if (!h.pattern && !h.integer && field != "real" && field != "double")
+    throw std::runtime_error("matrix_market: campo non supportato: " + field);
+
+  h.symmetric = symmetry == "symmetric" || symmetry == "skew-symmetric";
+  h.skew = symmetry == "skew-symmetric";
+  if (!h.symmetric && symmetry != "general")
+    throw std::runtime_error("matrix_market: simmetria non supportata: " +
+                             symmetry);
+
+  // commenti e righe vuote fino alla riga delle dimensioni
+  while (std::getline(in, line))
+  {
+    std::size_t p = line.find_first_not_of(" \t\r");
+    if (p != std::string::npos && line[p] != '%')
+      break;
+  }
+
+  std::istringstream size(line);
+  size.imbue(std::locale::classic());
+  if (!(size >> h.rows >> h.cols >> h.nnz))
+    throw std::runtime_error("matrix_market: riga delle dimensioni errata");
+  return h;
+}
+
+inline void skip_blanks(const char *&p, const char *end)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    p++;
+}
+
+/**
+ * Legge un intero decimale senza segno. Come le altre funzioni di lettura
+ * dei numeri, non dipende dal locale del processo.
+ */
+inline bool parse_unsigned(const char *&p, const char *end, std::uint64_t &out)
+{
+  if (p == end || *p < '0' || *p > '9')
+    return false;
+  const std::uint64_t max = std::numeric_limits<std::uint64_t>::max();
+  std::uint64_t v = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; p++)
+  {
+    unsigned int d = static_cast<unsigned int>(*p - '0');
+    if (v > (max - d) / 10)
+      return false;
+    v = v * 10 + d;
+  }
+  out = v;
+  return true;
+}
+
+/**
+ * Legge un indice a base 1 e lo converte a base 0.
+ */
+inline bool parse_index(const char *&p, const char *end, std::uint64_t bound,
+                        std::uint64_t &out)
+{
+  skip_blanks(p, end);
+  std::uint64_t v;
+  if (!parse_unsigned(p, end, v) || v == 0 || v > bound)
+    return false;
+  out = v - 1;
+  return true;
+}
+
+/**
+ * Lettore dei numeri reali con la punteggiatura del locale "C" (punto
+ * decimale), qualunque sia il locale globale: usa std::from_chars se
+ * disponibile, altrimenti il facet num_get del locale classico.
+ */
+class real_reader
+{
+public:
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  template <typename V>
+  bool read(const char *&p, const char *end, V &out) const
+  {
+    if (p < end && *p == '+')
+      p++;
+    std::from_chars_result r = std::from_chars(p, end, out);
+    if (r.ec != std::errc() || r.ptr == p)
+      return false;
+    p = r.ptr;
+    return true;
+  }
+#else
+  real_reader() { _format.imbue(classic()); }
+
+  template <typename V>
+  bool read(const char *&p, const char *end, V &out)
+  {
+    std::ios_base::iostate err = std::ios_base::goodbit;
+    const char *next =
+        std::use_facet<facet>(classic()).get(p, end, _format, err, out);
+    if ((err & std::ios_base::failbit) || next == p)
+      return false;
+    p = next;
+    return true;
+  }
+
+private:
+  typedef std::num_get<char, const char *> facet;
+
+  std::istringstream _format; ///< fornisce il locale e i flag a num_get
+
+  static const std::locale &classic()
+  {
+    static const std::locale loc(std::locale::classic(), new facet);
+    return loc;
+  }
+#endif
+};
+
+// interi: cifre decimali con segno opzionale, con controllo dei limiti di V
+template <typename V>
+bool parse_number(const char *&p, const char *end, real_reader &, V &out,
+                  std::true_type)
+{
+  bool negative = *p == '-';
+  if (*p == '-' || *p == '+')
+    p++;
+  std::uint64_t u;
+  if (!parse_unsigned(p, end, u))
+    return false;
+
+  if (!negative)
+  {
+    if (u > static_cast<std::uint64_t>(std::numeric_limits<V>::max()))
+      return false;
+    out = static_cast<V>(u);
+  }
+  else if (u == 0)
+    out = V(0);
+  else
+  {
+    if (!std::numeric_limits<V>::is_signed ||
+        u - 1 > static_cast<std::uint64_t>(std::numeric_limits<V>::max()))
+      return false;
+    out = static_cast<V>(-static_cast<std::int64_t>(u - 1) - 1);
+  }
+  return true;
+}
+
+// reali
+template <typename V>
+bool parse_number(const char *&p, const char *end, real_reader &reals,
+                  V &out, std::false_type)
+{
+  return reals.read(p, end, out);
+}
+
+/**
+ * Legge il valore di un elemento. I file real sono letti solo in tipi
+ * reali (vedi read_matrix_market()).
+ */
+template <typename T>
+bool parse_value(const char *&p, const char *end, const header &h,
+                 real_reader &reals, T &out)
+{
+  if (h.pattern)
+  {
+    out = T(1);
+    return true;
+  }
+
+  skip_blanks(p, end);
+  if (p == end || *p == '\n')
+    return false;
+
+  return parse_number(
+      p, end, reals, out,
+      std::integral_constant<bool, std::is_integral<T>::value>());
+}
+
+/**
+ * Interpreta le righe di dati in [p, end), che termina con un a capo,
+ * accodando le terne (a base 0) in out; per le matrici simmetriche accoda
+ * anche l'elemento speculare.
+ *
+ * @return numero di righe di dati lette
+ *
+ * @throw std::runtime_error se una riga non e' valida
+ */
+template <typename Triplet, typename T>
+std::uint64_t parse_block(const char *p, const char *end, const header &h,
+                          std::vector<Triplet> &out)
+{
+  std::uint64_t lines = 0;
+  real_reader reals;
+  while (p < end)
+  {
+    skip_blanks(p, end);
+    if (*p == '\n' || *p == '%')
+    {
+      while (*p != '\n')
+        p++;
+      p++;
+      continue;
+    }
+
+    std::uint64_t r, c;
+    T v;
+    if (!parse_index(p, end, h.rows, r) || !parse_index(p, end, h.cols, c) ||
+        !parse_value(p, end, h, reals, v))
+      throw std::runtime_error("matrix_market: riga di dati non valida");
+
+    skip_blanks(p, end);
+    if (*p != '\n')
+      throw std::runtime_error("matrix_market: riga di dati non valida");
+    p++;
+
+    typedef decltype(out.back().row) index;
+    out.push_back(Triplet(v, static_cast<index>(r), static_cast<index>(c)));
+    if (h.symmetric && r != c)
+      out.push_back(Triplet(h.skew ? T(-v) : v, static_cast<index>(c),
+                            static_cast<index>(r)));
+    lines++;
+  }
+  return lines;
+}
+
+} // namespace matrix_market
+
+/**
+ * Legge una matrice in formato Matrix Market coordinato (general,
+ * symmetric o skew-symmetric; real, integer o pattern).
+ *
+ * Il file viene letto a blocchi di chunk_size byte; ogni blocco, troncato
+ * all'ultimo a capo, viene diviso in threads intervalli di righe complete
+ * interpretati in parallelo. Le terne vengono caricate con un'unica
+ * assign_triplets(), senza inserimenti singoli. La matrice risultato ha
+ * le dimensioni dichiarate nel file (fisse); le celle assenti valgono
+ * default_value. I numeri sono letti sempre con il punto decimale, qualunque
+ * sia il locale del processo, e un file real non viene letto in un tipo T
+ * intero, che ne troncherebbe i valori.
+ *
+ * @param in stream di input
+ * @param default_value valore di default della matrice
+ * @param threads numero di thread da usare (0 = thread hardware)
+ * @param chunk_size dimensione in byte dei blocchi letti
+ *
+ * @return matrice letta
+ *
+ * @throw std::runtime_error se il file non e' valido, se un valore non e'
+ *        rappresentabile in T o se il file e' real e T e' intero
+ * @throw eccezione di allocazione della memoria
+ * @throw std::system_error se non e' possibile creare un thread
+ */
+template <typename T, typename E, typename A = std::allocator<T>,
+          typename I = unsigned int>
+sparse_matrix<T, E, A, I>
+read_matrix_market(std::istream &in, const T &default_value,
+                   unsigned int threads = 1,
+                   std::size_t chunk_size = std::size_t(1) << 24)
+{
+  static_assert(std::is_arithmetic<T>::value,
+                "read_matrix_market richiede un tipo aritmetico");
+  typedef typename sparse_matrix<T, E, A, I>::triplet triplet;
+
+  const matrix_market::header h = matrix_market::read_header(in);
+  if (h.rows > std::numeric_limits<I>::max() - 1 ||
+      h.cols > std::numeric_limits<I>::max() - 1)
+    throw std::runtime_error("matrix_market: dimensioni troppo grandi");
+  if (std::is_integral<T>::value && !h.integer && !h.pattern)
+    throw std::runtime_error("matrix_market: valori reali in un tipo intero");
+
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<triplet> entries;
+  entries.reserve(h.symmetric ? 2 * h.nnz : h.nnz);
+  std::vector<std::vector<triplet> > parts(threads);
+  std::vector<std::uint64_t> counts(threads);
+  std::uint64_t lines = 0;
+
+  std::vector<char> buf;
+  std::size_t carry = 0; // byte di una riga incompleta del blocco precedente
+  bool eof = false;
+  while (!eof)
+  {
+    buf.resize(carry + chunk_size + 1);
+    in.read(buf.data() + carry, static_cast<std::streamsize>(chunk_size));
+    std::size_t len = carry + static_cast<std::size_t>(in.gcount());
+    eof = !in;
+
+    // il blocco viene interpretato fino all'ultimo a capo
+    std::size_t stop = len;
+    if (eof)
+    {
+      if (len > 0 && buf[len - 1] != '\n')
+        buf[len++] = '\n';
+      stop = len;
+    }
+    else
+    {
+      while (stop > 0 && buf[stop - 1] != '\n')
+        stop--;
+    }
+
+    // confini degli intervalli allineati all'inizio di una riga
+    std::vector<std::size_t> bounds(threads + 1, stop);
+    bounds[0] = 0;
+    for (unsigned int t = 1; t < threads; t++)
+    {
+      std::size_t b = std::max(bounds[t - 1], stop * t / threads);
+      while (b > bounds[t - 1] && b < stop && buf[b - 1] != '\n')
+        b++;
+      bounds[t] = b;
+    }
+
+    const char *base = buf.data();
+    sparse_kernels::run_parallel(threads, [&](unsigned int t) {
+      parts[t].clear();
+      counts[t] = matrix_market::parse_block<triplet, T>(
+          base + bounds[t], base + bounds[t + 1], h, parts[t]);
+    });
+
+    for (unsigned int t = 0; t < threads; t++)
+    {
+      entries.insert(entries.end(), parts[t].begin(), parts[t].end());
+      lines += counts[t];
+    }
+
+    carry = len - stop;
+    std::copy(buf.begin() + stop, buf.begin() + len, buf.begin());
+  }
+
+  if (lines != h.nnz)
+    throw std::runtime_error("matrix_market: numero di elementi errato");
+
+  sparse_matrix<T, E, A, I> m(static_cast<I>(h.rows), static_cast<I>(h.cols),
+                              default_value);
+  m.assign_triplets(entries.begin(), entries.end(), merge_last());
+  return m;
+}
+
+/**
+ * Legge una matrice in formato Matrix Market coordinato da un file.
+ *
+ * @param path percorso del file
+ * @param default_value valore di default della matrice
+ * @param threads numero di thread da usare (0 = thread hardware)
+ *
+ * @return matrice letta
+ *
+ * @throw std::runtime_error se il file non puo' essere aperto o non e'
+ *        valido
+ */
+template <typename T, typename E, typename A = std::allocator<T>,
+          typename I = unsigned int>
+sparse_matrix<T, E, A, I> read_matrix_market(const std::string &path,
+                                             const T &default_value,
+                                             unsigned int threads = 1)
+{
+  std::ifstream in(path.c_str(), std::ios::binary);
+  if (!in)
+    throw std::runtime_error("matrix_market: impossibile aprire " + path);
+  return read_matrix_market<T, E, A, I>(in, default_value, threads);
+}
+
+/**
+ * Scrive gli elementi inseriti di una matrice in formato Matrix Market
+ * coordinato, con indici a base 1. Le celle non scritte sono implicite:
+ * rileggendo il file va indicato lo stesso valore di default.
+ *
+ * @param out stream di output
+ * @param sm matrice da scrivere
+ * @param symmetric se true scrive solo il triangolo inferiore con
+ *        l'intestazione symmetric (la matrice deve essere simmetrica)
+ *
+ * @throw std::runtime_error se la scrittura fallisce
+ */
+template <typename T, typename E, typename A, typename I>
+void write_matrix_market(std::ostream &out, const sparse_matrix<T, E, A, I> &sm,
+                         bool symmetric = false)
+{
+  static_assert(std::is_arithmetic<T>::value,
+                "write_matrix_market richiede un tipo aritmetico");
+
+  typename sparse_matrix<T, E, A, I>::const_iterator it;
+  std::uint64_t nnz = 0;
+  if (symmetric)
+  {
+    for (it = sm.begin(); it != sm.end(); ++it)
+      if (it->row >= it->col)
+        nnz++;
+  }
+  else
+    nnz = sm.get_size();
+
+  out << "%%MatrixMarket matrix coordinate "
+      << (std::is_integral<T>::value ? "integer" : "real") << ' '
+      << (symmetric ? "symmetric" : "general") << '\n';
+  out << sm.get_rows() << ' ' << sm.get_columns() << ' ' << nnz << '\n';
+
+  std::streamsize precision = out.precision();
+  if (std::is_floating_point<T>::value)
+    out.precision(std::numeric_limits<T>::max_digits10);
+
+  for (it = sm.begin(); it != sm.end(); ++it)
+  {
+    if (symmetric && it->row < it->col)
+      continue;
+    out << static_cast<std::uint64_t>(it->row) + 1 << ' '
+        << static_cast<std::uint64_t>(it->col) + 1 << ' ' << +it->value
+        << '\n';
+  }
+
+  out.precision(precision);
+  if (!out)
+    throw std::runtime_error("matrix_market: errore di scrittura");
+}
+
+/**
+ * Scrive una matrice in formato Matrix Market coordinato su file.
+ *
+ * @param path percorso del file
+ * @param sm matrice da scrivere
+ * @param symmetric se true scrive solo il triangolo inferiore
+ *
+ * @throw std::runtime_error se il file non puo' essere scritto
+ */
+template <typename T, typename E, typename A, typename I>
+void write_matrix_market(const std::string &path,
+                         const sparse_matrix<T, E, A, I> &sm,
+                         bool symmetric = false)
+{
+  std::ofstream out(path.c_str(), std::ios::binary);
+  if (!out)
+    throw std::runtime_error("matrix_market: impossibile creare " + path);
+  write_matrix_market(out, sm, symmetric);
+}
+
+#endif // MATRIX_MARKET_H
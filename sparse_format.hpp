@@ -0,0 +1,276 @@
+#ifndef SPARSE_FORMAT_H
+#define SPARSE_FORMAT_H
+
+#include <cstddef>     // std::size_t
+#include <cstdint>     // std::uint64_t
+#include <cstdio>      // std::snprintf
+#include <cstring>     // std::memcpy, std::strlen
+#include <ios>         // std::ios_base
+#include <limits>      // std::numeric_limits
+#include <locale>      // std::locale
+#include <ostream>     // std::ostream
+#include <string>      // std::string
+#include <type_traits> // std::is_integral, std::is_floating_point
+#include <vector>      // std::vector
+#if __cplusplus >= 201703L
+#include <charconv> // std::to_chars
+#endif
+
+/**
+ * Supporto per la stampa formattata veloce delle matrici sparse: i
+ * caratteri vengono accumulati in un buffer e scritti sullo stream a
+ * blocchi, e i numeri vengono convertiti senza passare dal meccanismo di
+ * formattazione degli stream.
+ */
+namespace sparse_format
+{
+
+/**
+ * Formato della stampa completa di show().
+ */
+enum layout
+{
+  grid, ///< righe precedute da un a capo e celle seguite da " | "
+  csv,  ///< celle separate da virgole, una riga per linea
+  tsv   ///< celle separate da tabulazioni, una riga per linea
+};
+
+/**
+ * Opzioni di show(): finestra di righe e colonne da stampare e formato.
+ * La finestra viene limitata alle dimensioni della matrice.
+ *
+ * @brief Opzioni di stampa
+ */
+struct print_options
+{
+  std::uint64_t first_row; ///< prima riga stampata
+  std::uint64_t rows;      ///< numero massimo di righe stampate
+  std::uint64_t first_col; ///< prima colonna stampata
+  std::uint64_t cols;      ///< numero massimo di colonne stampate
+  layout format;           ///< formato delle celle
+
+  /**
+   * Costruttore che seleziona l'intera matrice.
+   *
+   * @param f formato delle celle
+   */
+  print_options(layout f = grid)
+      : first_row(0), rows(std::numeric_limits<std::uint64_t>::max()),
+        first_col(0), cols(std::numeric_limits<std::uint64_t>::max()),
+        format(f) {}
+
+  /**
+   * Costruttore con una finestra di righe e colonne.
+   *
+   * @param r0 prima riga
+   * @param nr numero di righe
+   * @param c0 prima colonna
+   * @param nc numero di colonne
+   * @param f formato delle celle
+   */
+  print_options(std::uint64_t r0, std::uint64_t nr, std::uint64_t c0,
+                std::uint64_t nc, layout f = grid)
+      : first_row(r0), rows(nr), first_col(c0), cols(nc), format(f) {}
+};
+
+/**
+ * Tipi interi stampati come numeri da operator<< (i tipi carattere
+ * vengono invece stampati come caratteri).
+ */
+template <typename V>
+struct is_number_integer
+    : std::integral_constant<
+          bool, std::is_integral<V>::value &&
+                    !std::is_same<V, char>::value &&
+                    !std::is_same<V, signed char>::value &&
+                    !std::is_same<V, unsigned char>::value &&
+                    !std::is_same<V, wchar_t>::value &&
+                    !std::is_same<V, char16_t>::value &&
+                    !std::is_same<V, char32_t>::value>
+{
+};
+
+/**
+ * Scrittore bufferizzato su uno stream. I numeri vengono formattati
+ * direttamente nel buffer quando lo stream usa la formattazione di
+ * default (a parte la precisione) e il locale classico, ottenendo gli
+ * stessi caratteri di operator<<; negli altri casi (ad esempio con un
+ * locale che raggruppa le migliaia o usa la virgola decimale), e per i
+ * tipi non numerici, il valore viene scritto con operator<< dopo aver
+ * svuotato il buffer.
+ *
+ * @brief Scrittore bufferizzato
+ */
+class writer
+{
+public:
+  /**
+   * Costruttore primario.
+   *
+   * @param out stream di destinazione
+   * @param capacity dimensione del buffer in byte
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  explicit writer(std::ostream &out, std::size_t capacity = 1 << 16)
+      : _out(out), _buf(capacity < 64 ? 64 : capacity), _n(0),
+        _plain((out.flags() & ~std::ios_base::skipws) == std::ios_base::dec &&
+               out.width() == 0 && out.getloc() == std::locale::classic()),
+        _precision(static_cast<int>(out.precision())) {}
+
+  /**
+   * Svuota il buffer sullo stream.
+   */
+  void flush()
+  {
+    if (_n > 0)
+      _out.write(_buf.data(), static_cast<std::streamsize>(_n));
+    _n = 0;
+  }
+
+  /**
+   * Accoda un carattere.
+   */
+  void put(char c)
+  {
+    if (_n == _buf.size())
+      flush();
+    _buf[_n++] = c;
+  }
+
+  /**
+   * Accoda n caratteri.
+   */
+  void text(const char *s, std::size_t n)
+  {
+    if (_n + n > _buf.size())
+    {
+      flush();
+      if (n > _buf.size())
+      {
+        _out.write(s, static_cast<std::streamsize>(n));
+        return;
+      }
+    }
+    std::memcpy(_buf.data() + _n, s, n);
+    _n += n;
+  }
+
+  /**
+   * Accoda una stringa terminata da zero.
+   */
+  void text(const char *s) { text(s, std::strlen(s)); }
+
+  /**
+   * Accoda un valore formattato come farebbe operator<<.
+   */
+  template <typename V>
+  void value(const V &v)
+  {
+    format(v, std::integral_constant<int, is_number_integer<V>::value ? 1
+                                          : std::is_floating_point<V>::value
+                                              ? 2
+                                              : 0>());
+  }
+
+  void value(const std::string &s)
+  {
+    if (_plain)
+      text(s.data(), s.size());
+    else
+      format(s, std::integral_constant<int, 0>());
+  }
+
+private:
+  std::ostream &_out;     ///< stream di destinazione
+  std::vector<char> _buf; ///< buffer dei caratteri
+  std::size_t _n;         ///< caratteri presenti nel buffer
+  bool _plain;            ///< lo stream usa la formattazione di default
+  int _precision;         ///< precisione dei numeri reali dello stream
+
+  /**
+   * Funzione di supporto che riserva n caratteri nel buffer.
+   */
+  char *reserve(std::size_t n)
+  {
+    if (_n + n > _buf.size())
+      flush();
+    return _buf.data() + _n;
+  }
+
+  // tipi generici: operator<< dello stream
+  template <typename V>
+  void format(const V &v, std::integral_constant<int, 0>)
+  {
+    flush();
+    _out << v;
+  }
+
+  // interi: conversione decimale a partire dalla cifra meno significativa
+  template <typename V>
+  void format(const V &v, std::integral_constant<int, 1>)
+  {
+    if (!_plain)
+      return format(v, std::integral_constant<int, 0>());
+
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    char *p = end;
+    bool negative = v < V(0);
+    typedef typename std::make_unsigned<
+        typename std::conditional<std::is_same<V, bool>::value, unsigned int,
+                                  V>::type>::type U;
+    U u = negative ? static_cast<U>(U(0) - static_cast<U>(v))
+                   : static_cast<U>(v);
+    do
+    {
+      *--p = static_cast<char>('0' + u % 10);
+      u /= 10;
+    } while (u != 0);
+    if (negative)
+      *--p = '-';
+    text(p, static_cast<std::size_t>(end - p));
+  }
+
+  // reali: %g con la precisione dello stream
+  template <typename V>
+  void format(const V &v, std::integral_constant<int, 2>)
+  {
+    if (!_plain || _precision > std::numeric_limits<V>::max_digits10 + 2)
+      return format(v, std::integral_constant<int, 0>());
+
+    const std::size_t room = 64;
+    char *p = reserve(room);
+    _n += real_to_text(p, room, v);
+  }
+
+  /**
+   * Funzioni di supporto che scrivono un reale in [p, p + room) con %g e
+   * ritornano il numero di caratteri scritti.
+   */
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  template <typename V>
+  std::size_t real_to_text(char *p, std::size_t room, V v) const
+  {
+    std::to_chars_result r = std::to_chars(
+        p, p + room, v, std::chars_format::general, _precision);
+    return static_cast<std::size_t>(r.ptr - p);
+  }
+#else
+  std::size_t real_to_text(char *p, std::size_t room, double v) const
+  {
+    return static_cast<std::size_t>(
+        std::snprintf(p, room, "%.*g", _precision, v));
+  }
+
+  std::size_t real_to_text(char *p, std::size_t room, long double v) const
+  {
+    return static_cast<std::size_t>(
+        std::snprintf(p, room, "%.*Lg", _precision, v));
+  }
+#endif
+};
+
+} // namespace sparse_format
+
+#endif // SPARSE_FORMAT_H
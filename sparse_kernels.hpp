@@ -0,0 +1,616 @@
+#ifndef SPARSE_KERNELS_H
+#define SPARSE_KERNELS_H
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::int32_t, std::int64_t, std::uint64_t
+#include <functional> // std::less, std::equal_to, std::greater
+#include <thread>     // std::thread
+#include <vector>     // std::vector
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SPARSE_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+/**
+ * Kernel di calcolo usati da sparse_matrix sugli array contigui di valori
+ * e indici di colonna.
+ *
+ * Per ogni operazione esiste una versione scalare generica; per float,
+ * double, int32 e int64 la struttura dispatch seleziona a tempo di
+ * compilazione le versioni vettoriali AVX2/AVX-512 e, a tempo di
+ * esecuzione, quella supportata dalla CPU, ricadendo sulla versione
+ * scalare. Gli indici di colonna sono estesi a 64 bit prima delle gather,
+ * per cui sono corretti anche oltre 2^31.
+ */
+namespace sparse_kernels
+{
+
+/**
+ * Esegue job(0), ..., job(n - 1) su n thread, di cui uno e' il thread
+ * chiamante, e ne attende la terminazione.
+ *
+ * @throw std::system_error se non e' possibile creare un thread
+ */
+template <typename J>
+void run_parallel(unsigned int n, J job)
+{
+  std::vector<std::thread> workers;
+  workers.reserve(n);
+
+  try
+  {
+    for (unsigned int t = 1; t < n; t++)
+      workers.push_back(std::thread(job, t));
+  }
+  catch (...)
+  {
+    for (unsigned int t = 0; t < workers.size(); t++)
+      workers[t].join();
+    throw;
+  }
+
+  if (n > 0)
+    job(0);
+
+  for (unsigned int t = 0; t < workers.size(); t++)
+    workers[t].join();
+}
+
+/**
+ * Contributo di n elementi di una riga al prodotto con x:
+ * sum (values[k] - d) * x[cols[k]], per indici di colonna di tipo Idx.
+ */
+template <typename V, typename Idx>
+V row_dot_scalar(const V *values, const Idx *cols, std::size_t n,
+                 const V *x, V d)
+{
+  V acc = V();
+  if (d == V())
+  {
+    for (std::size_t k = 0; k < n; k++)
+      acc += values[k] * x[cols[k]];
+  }
+  else
+  {
+    for (std::size_t k = 0; k < n; k++)
+      acc += (values[k] - d) * x[cols[k]];
+  }
+  return acc;
+}
+
+/**
+ * Somma di n valori.
+ */
+template <typename V>
+V sum_scalar(const V *values, std::size_t n)
+{
+  V sum = V();
+  for (std::size_t k = 0; k < n; k++)
+    sum += values[k];
+  return sum;
+}
+
+/**
+ * Numero di valori v tali che cmp(v, t).
+ */
+template <typename V, typename C>
+std::uint64_t count_scalar(const V *values, std::size_t n, C cmp, V t)
+{
+  std::uint64_t count = 0;
+  for (std::size_t k = 0; k < n; k++)
+    if (cmp(values[k], t))
+      count++;
+  return count;
+}
+
+/**
+ * Confronti vettorizzabili: associa std::less, std::equal_to e
+ * std::greater a un codice di operazione. Gli altri predicati restano
+ * scalari.
+ */
+enum cmp_op
+{
+  cmp_less,
+  cmp_equal,
+  cmp_greater,
+  cmp_other
+};
+
+template <typename C, typename V>
+struct cmp_traits
+{
+  static const cmp_op op = cmp_other;
+};
+
+template <typename V>
+struct cmp_traits<std::less<V>, V>
+{
+  static const cmp_op op = cmp_less;
+};
+
+template <typename V>
+struct cmp_traits<std::equal_to<V>, V>
+{
+  static const cmp_op op = cmp_equal;
+};
+
+template <typename V>
+struct cmp_traits<std::greater<V>, V>
+{
+  static const cmp_op op = cmp_greater;
+};
+
+#ifdef SPARSE_KERNELS_X86
+
+/**
+ * Rilevamento delle estensioni della CPU, eseguito una sola volta.
+ */
+inline bool has_avx2()
+{
+  static const bool r = __builtin_cpu_supports("avx2") &&
+                        __builtin_cpu_supports("fma");
+  return r;
+}
+
+inline bool has_avx512()
+{
+  static const bool r = __builtin_cpu_supports("avx512f") &&
+                        __builtin_cpu_supports("avx512dq");
+  return r;
+}
+
+// ---------------------------------------------------------------- AVX2
+
+__attribute__((target("avx2,fma"))) inline double
+hsum_avx2(__m256d v)
+{
+  __m128d lo = _mm256_castpd256_pd128(v);
+  __m128d hi = _mm256_extractf128_pd(v, 1);
+  lo = _mm_add_pd(lo, hi);
+  return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+__attribute__((target("avx2,fma"))) inline float
+hsum_avx2(__m256 v)
+{
+  __m128 lo = _mm256_castps256_ps128(v);
+  __m128 hi = _mm256_extractf128_ps(v, 1);
+  lo = _mm_add_ps(lo, hi);
+  lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+  return _mm_cvtss_f32(_mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1)));
+}
+
+__attribute__((target("avx2,fma"))) inline std::int32_t
+hsum_epi32_avx2(__m256i v)
+{
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+                            _mm256_extracti128_si256(v, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+  return _mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("avx2,fma"))) inline std::int64_t
+hsum_epi64_avx2(__m256i v)
+{
+  __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v),
+                            _mm256_extracti128_si256(v, 1));
+  s = _mm_add_epi64(s, _mm_unpackhi_epi64(s, s));
+  return _mm_cvtsi128_si64(s);
+}
+
+// indici di colonna estesi a 64 bit, 4 alla volta
+__attribute__((target("avx2,fma"))) inline __m256i
+load_idx4_avx2(const unsigned int *cols)
+{
+  return _mm256_cvtepu32_epi64(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(cols)));
+}
+
+__attribute__((target("avx2,fma"))) inline double
+row_dot_avx2(const double *values, const unsigned int *cols, std::size_t n,
+             const double *x, double d)
+{
+  const __m256d vd = _mm256_set1_pd(d);
+  __m256d acc = _mm256_setzero_pd();
+  std::size_t k = 0;
+  for (; k + 4 <= n; k += 4)
+  {
+    __m256d xv = _mm256_i64gather_pd(x, load_idx4_avx2(cols + k), 8);
+    __m256d v = _mm256_sub_pd(_mm256_loadu_pd(values + k), vd);
+    acc = _mm256_fmadd_pd(v, xv, acc);
+  }
+  return hsum_avx2(acc) + row_dot_scalar(values + k, cols + k, n - k, x, d);
+}
+
+__attribute__((target("avx2,fma"))) inline float
+row_dot_avx2(const float *values, const unsigned int *cols, std::size_t n,
+             const float *x, float d)
+{
+  const __m256 vd = _mm256_set1_ps(d);
+  __m256 acc = _mm256_setzero_ps();
+  std::size_t k = 0;
+  for (; k + 8 <= n; k += 8)
+  {
+    __m128 lo = _mm256_i64gather_ps(x, load_idx4_avx2(cols + k), 4);
+    __m128 hi = _mm256_i64gather_ps(x, load_idx4_avx2(cols + k + 4), 4);
+    __m256 xv = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+    __m256 v = _mm256_sub_ps(_mm256_loadu_ps(values + k), vd);
+    acc = _mm256_fmadd_ps(v, xv, acc);
+  }
+  return hsum_avx2(acc) + row_dot_scalar(values + k, cols + k, n - k, x, d);
+}
+
+__attribute__((target("avx2,fma"))) inline std::int32_t
+row_dot_avx2(const std::int32_t *values, const unsigned int *cols,
+             std::size_t n, const std::int32_t *x, std::int32_t d)
+{
+  const int *xi = reinterpret_cast<const int *>(x);
+  const __m256i vd = _mm256_set1_epi32(d);
+  __m256i acc = _mm256_setzero_si256();
+  std::size_t k = 0;
+  for (; k + 8 <= n; k += 8)
+  {
+    __m128i lo = _mm256_i64gather_epi32(xi, load_idx4_avx2(cols + k), 4);
+    __m128i hi = _mm256_i64gather_epi32(xi, load_idx4_avx2(cols + k + 4), 4);
+    __m256i xv = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    __m256i v = _mm256_sub_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + k)), vd);
+    acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(v, xv));
+  }
+  return hsum_epi32_avx2(acc) +
+         row_dot_scalar(values + k, cols + k, n - k, x, d);
+}
+
+// AVX2 non ha la moltiplicazione a 64 bit: il prodotto resta scalare
+inline std::int64_t
+row_dot_avx2(const std::int64_t *values, const unsigned int *cols,
+             std::size_t n, const std::int64_t *x, std::int64_t d)
+{
+  return row_dot_scalar(values, cols, n, x, d);
+}
+
+__attribute__((target("avx2,fma"))) inline double
+sum_avx2(const double *values, std::size_t n)
+{
+  __m256d acc = _mm256_setzero_pd();
+  std::size_t k = 0;
+  for (; k + 4 <= n; k += 4)
+    acc = _mm256_add_pd(acc, _mm256_loadu_pd(values + k));
+  return hsum_avx2(acc) + sum_scalar(values + k, n - k);
+}
+
+__attribute__((target("avx2,fma"))) inline float
+sum_avx2(const float *values, std::size_t n)
+{
+  __m256 acc = _mm256_setzero_ps();
+  std::size_t k = 0;
+  for (; k + 8 <= n; k += 8)
+    acc = _mm256_add_ps(acc, _mm256_loadu_ps(values + k));
+  return hsum_avx2(acc) + sum_scalar(values + k, n - k);
+}
+
+__attribute__((target("avx2,fma"))) inline std::int32_t
+sum_avx2(const std::int32_t *values, std::size_t n)
+{
+  __m256i acc = _mm256_setzero_si256();
+  std::size_t k = 0;
+  for (; k + 8 <= n; k += 8)
+    acc = _mm256_add_epi32(
+        acc, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + k)));
+  return hsum_epi32_avx2(acc) + sum_scalar(values + k, n - k);
+}
+
+__attribute__((target("avx2,fma"))) inline std::int64_t
+sum_avx2(const std::int64_t *values, std::size_t n)
+{
+  __m256i acc = _mm256_setzero_si256();
+  std::size_t k = 0;
+  for (; k + 4 <= n; k += 4)
+    acc = _mm256_add_epi64(
+        acc, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + k)));
+  return hsum_epi64_avx2(acc) + sum_scalar(values + k, n - k);
+}
+
+// maschera dei confronti (v OP t) per 4 double
+template <cmp_op OP>
+__attribute__((target("avx2,fma"))) inline int
+cmp_mask_avx2(__m256d v, __m256d t)
+{
+  return _mm256_movemask_pd(_mm256_cmp_pd(
+      v, t, OP == cmp_less ? _CMP_LT_OQ
+                           : (OP == cmp_equal ? _CMP_EQ_OQ : _CMP_GT_OQ)));
+}
+
+// maschera dei confronti (v OP t) per 8 float
+template <cmp_op OP>
+__attribute__((target("avx2,fma"))) inline int
+cmp_mask_avx2(__m256 v, __m256 t)
+{
+  return _mm256_movemask_ps(_mm256_cmp_ps(
+      v, t, OP == cmp_less ? _CMP_LT_OQ
+                           : (OP == cmp_equal ? _CMP_EQ_OQ : _CMP_GT_OQ)));
+}
+
+// maschera dei confronti (v OP t) per 8 int32
+template <cmp_op OP>
+__attribute__((target("avx2,fma"))) inline int
+cmp_mask_epi32_avx2(__m256i v, __m256i t)
+{
+  __m256i m = OP == cmp_less ? _mm256_cmpgt_epi32(t, v)
+                             : (OP == cmp_equal ? _mm256_cmpeq_epi32(v, t)
+                                                : _mm256_cmpgt_epi32(v, t));
+  return _mm256_movemask_ps(_mm256_castsi256_ps(m));
+}
+
+// maschera dei confronti (v OP t) per 4 int64
+template <cmp_op OP>
+__attribute__((target("avx2,fma"))) inline int
+cmp_mask_epi64_avx2(__m256i v, __m256i t)
+{
+  __m256i m = OP == cmp_less ? _mm256_cmpgt_epi64(t, v)
+                             : (OP == cmp_equal ? _mm256_cmpeq_epi64(v, t)
+                                                : _mm256_cmpgt_epi64(v, t));
+  return _mm256_movemask_pd(_mm256_castsi256_pd(m));
+}
+
+template <cmp_op OP, typename C>
+__attribute__((target("avx2,fma"))) inline std::uint64_t
+count_avx2(const double *values, std::size_t n, C cmp, double t)
+{
+  const __m256d vt = _mm256_set1_pd(t);
+  std::uint64_t count = 0;
+  std::size_t k = 0;
+  for (; k + 4 <= n; k += 4)
+    count += __builtin_popcount(
+        cmp_mask_avx2<OP>(_mm256_loadu_pd(values + k), vt));
+  return count + count_scalar(values + k, n - k, cmp, t);
+}
+
+template <cmp_op OP, typename C>
+__attribute__((target("avx2,fma"))) inline std::uint64_t
+count_avx2(const float *values, std::size_t n, C cmp, float t)
+{
+  const __m256 vt = _mm256_set1_ps(t);
+  std::uint64_t count = 0;
+  std::size_t k = 0;
+  for (; k + 8 <= n; k += 8)
+    count += __builtin_popcount(
+        cmp_mask_avx2<OP>(_mm256_loadu_ps(values + k), vt));
+  return count + count_scalar(values + k, n - k, cmp, t);
+}
+
+template <cmp_op OP, typename C>
+__attribute__((target("avx2,fma"))) inline std::uint64_t
+count_avx2(const std::int32_t *values, std::size_t n, C cmp, std::int32_t t)
+{
+  const __m256i vt = _mm256_set1_epi32(t);
+  std::uint64_t count = 0;
+  std::size_t k = 0;
+  for (; k + 8 <= n; k += 8)
+    count += __builtin_popcount(cmp_mask_epi32_avx2<OP>(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + k)),
+        vt));
+  return count + count_scalar(values + k, n - k, cmp, t);
+}
+
+template <cmp_op OP, typename C>
+__attribute__((target("avx2,fma"))) inline std::uint64_t
+count_avx2(const std::int64_t *values, std::size_t n, C cmp, std::int64_t t)
+{
+  const __m256i vt = _mm256_set1_epi64x(t);
+  std::uint64_t count = 0;
+  std::size_t k = 0;
+  for (; k + 4 <= n; k += 4)
+    count += __builtin_popcount(cmp_mask_epi64_avx2<OP>(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + k)),
+        vt));
+  return count + count_scalar(values + k, n - k, cmp, t);
+}
+
+// ------------------------------------------------------------- AVX-512
+
+// gli header AVX-512 di GCC 12 generano falsi positivi su _mm512_undefined
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f,avx512dq"))) inline double
+row_dot_avx512(const double *values, const unsigned int *cols, std::size_t n,
+               const double *x, double d)
+{
+  const __m512d vd = _mm512_set1_pd(d);
+  __m512d acc = _mm512_setzero_pd();
+  std::size_t k = 0;
+  for (; k + 8 <= n; k += 8)
+  {
+    __m512i idx = _mm512_cvtepu32_epi64(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cols + k)));
+    __m512d xv = _mm512_i64gather_pd(idx, x, 8);
+    __m512d v = _mm512_sub_pd(_mm512_loadu_pd(values + k), vd);
+    acc = _mm512_fmadd_pd(v, xv, acc);
+  }
+  return _mm512_reduce_add_pd(acc) +
+         row_dot_scalar(values + k, cols + k, n - k, x, d);
+}
+
+__attribute__((target("avx512f,avx512dq"))) inline float
+row_dot_avx512(const float *values, const unsigned int *cols, std::size_t n,
+               const float *x, float d)
+{
+  const __m512 vd = _mm512_set1_ps(d);
+  __m512 acc = _mm512_setzero_ps();
+  std::size_t k = 0;
+  for (; k + 16 <= n; k += 16)
+  {
+    __m512i lo = _mm512_cvtepu32_epi64(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cols + k)));
+    __m512i hi = _mm512_cvtepu32_epi64(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cols + k + 8)));
+    __m512 xv = _mm512_insertf32x8(
+        _mm512_castps256_ps512(_mm512_i64gather_ps(lo, x, 4)),
+        _mm512_i64gather_ps(hi, x, 4), 1);
+    __m512 v = _mm512_sub_ps(_mm512_loadu_ps(values + k), vd);
+    acc = _mm512_fmadd_ps(v, xv, acc);
+  }
+  return _mm512_reduce_add_ps(acc) +
+         row_dot_scalar(values + k, cols + k, n - k, x, d);
+}
+
+__attribute__((target("avx512f,avx512dq"))) inline std::int32_t
+row_dot_avx512(const std::int32_t *values, const unsigned int *cols,
+               std::size_t n, const std::int32_t *x, std::int32_t d)
+{
+  const __m512i vd = _mm512_set1_epi32(d);
+  __m512i acc = _mm512_setzero_si512();
+  std::size_t k = 0;
+  for (; k + 16 <= n; k += 16)
+  {
+    __m512i lo = _mm512_cvtepu32_epi64(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cols + k)));
+    __m512i hi = _mm512_cvtepu32_epi64(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cols + k + 8)));
+    __m512i xv = _mm512_inserti64x4(
+        _mm512_castsi256_si512(_mm512_i64gather_epi32(lo, x, 4)),
+        _mm512_i64gather_epi32(hi, x, 4), 1);
+    __m512i v = _mm512_sub_epi32(_mm512_loadu_si512(values + k), vd);
+    acc = _mm512_add_epi32(acc, _mm512_mullo_epi32(v, xv));
+  }
+  return _mm512_reduce_add_epi32(acc) +
+         row_dot_scalar(values + k, cols + k, n - k, x, d);
+}
+
+__attribute__((target("avx512f,avx512dq"))) inline std::int64_t
+row_dot_avx512(const std::int64_t *values, const unsigned int *cols,
+               std::size_t n, const std::int64_t *x, std::int64_t d)
+{
+  const __m512i vd = _mm512_set1_epi64(d);
+  __m512i acc = _mm512_setzero_si512();
+  std::size_t k = 0;
+  for (; k + 8 <= n; k += 8)
+  {
+    __m512i idx = _mm512_cvtepu32_epi64(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cols + k)));
+    __m512i xv = _mm512_i64gather_epi64(idx, x, 8);
+    __m512i v = _mm512_sub_epi64(_mm512_loadu_si512(values + k), vd);
+    acc = _mm512_add_epi64(acc, _mm512_mullo_epi64(v, xv));
+  }
+  return _mm512_reduce_add_epi64(acc) +
+         row_dot_scalar(values + k, cols + k, n - k, x, d);
+}
+
+#pragma GCC diagnostic pop
+
+#endif // SPARSE_KERNELS_X86
+
+/**
+ * Selezione dei kernel per il tipo V. La versione generica usa sempre i
+ * kernel scalari; le specializzazioni per float, double, int32 e int64
+ * scelgono a tempo di esecuzione la versione vettoriale migliore.
+ *
+ * @brief Selezione dei kernel
+ */
+template <typename V>
+struct dispatch
+{
+  typedef V (*row_dot_fn)(const V *, const unsigned int *, std::size_t,
+                          const V *, V);
+
+  static row_dot_fn row_dot() { return &row_dot_scalar<V, unsigned int>; }
+
+  static V sum(const V *values, std::size_t n)
+  {
+    return sum_scalar(values, n);
+  }
+
+  template <typename C>
+  static std::uint64_t count(const V *values, std::size_t n, C cmp, V t)
+  {
+    return count_scalar(values, n, cmp, t);
+  }
+};
+
+#ifdef SPARSE_KERNELS_X86
+
+/**
+ * Selezione dei kernel vettoriali, comune ai tipi specializzati.
+ */
+template <typename V>
+struct simd_dispatch
+{
+  typedef V (*row_dot_fn)(const V *, const unsigned int *, std::size_t,
+                          const V *, V);
+
+  static row_dot_fn row_dot()
+  {
+    if (has_avx512())
+      return &row_dot_avx512;
+    if (has_avx2())
+      return &row_dot_avx2;
+    return &row_dot_scalar<V, unsigned int>;
+  }
+
+  static V sum(const V *values, std::size_t n)
+  {
+    return has_avx2() ? sum_avx2(values, n) : sum_scalar(values, n);
+  }
+
+  template <typename C>
+  static std::uint64_t count(const V *values, std::size_t n, C cmp, V t)
+  {
+    const cmp_op op = cmp_traits<C, V>::op;
+    if (op == cmp_other || !has_avx2())
+      return count_scalar(values, n, cmp, t);
+    return count_avx2<op == cmp_other ? cmp_less : op>(values, n, cmp, t);
+  }
+};
+
+template <>
+struct dispatch<double> : simd_dispatch<double>
+{
+};
+
+template <>
+struct dispatch<float> : simd_dispatch<float>
+{
+};
+
+template <>
+struct dispatch<std::int32_t> : simd_dispatch<std::int32_t>
+{
+};
+
+template <>
+struct dispatch<std::int64_t> : simd_dispatch<std::int64_t>
+{
+};
+
+#endif // SPARSE_KERNELS_X86
+
+/**
+ * Selezione del kernel di riga per valori di tipo V e indici di colonna di
+ * tipo Idx. Le versioni vettoriali leggono indici a 32 bit, per cui con
+ * indici di altro tipo si usa il kernel scalare.
+ *
+ * @brief Selezione del kernel di riga
+ */
+template <typename V, typename Idx>
+struct row_dispatch
+{
+  typedef V (*row_dot_fn)(const V *, const Idx *, std::size_t, const V *, V);
+
+  static row_dot_fn row_dot() { return &row_dot_scalar<V, Idx>; }
+};
+
+template <typename V>
+struct row_dispatch<V, unsigned int>
+{
+  typedef typename dispatch<V>::row_dot_fn row_dot_fn;
+
+  static row_dot_fn row_dot() { return dispatch<V>::row_dot(); }
+};
+
+} // namespace sparse_kernels
+
+#endif // SPARSE_KERNELS_H
@@ -4,40 +4,113 @@
 #include <iostream> // std::ostream
 #include <iterator> // std::forward_iterator_tag
 #include <cstddef>  // std::ptrdiff_t
+#include <memory>   // std::allocator, std::allocator_traits
+#include <utility>  // std::swap, std::move_if_noexcept
+#include <algorithm> // std::copy, std::lower_bound, std::move_backward
+#include <vector>   // std::vector
+#include <cstdint>  // std::uint64_t
+#include <stdexcept> // std::invalid_argument, std::out_of_range
+#include <type_traits> // std::is_arithmetic
+#include <limits>   // std::numeric_limits
+#include "sparse_kernels.hpp"
+#include "csr_matrix.hpp"
+#include "csc_matrix.hpp"
+#include "bsr_matrix.hpp"
+#include "sparse_format.hpp"
+
+/**
+ * Politica di fusione dei duplicati per sparse_matrix::from_triplets:
+ * a parita' di coordinate vince l'ultimo valore della sequenza.
+ *
+ * @brief Fusione dei duplicati: vince l'ultimo
+ */
+struct merge_last
+{
+  template <typename T>
+  void operator()(T &current, const T &incoming) const
+  {
+    current = incoming;
+  }
+};
+
+/**
+ * Politica di fusione dei duplicati per sparse_matrix::from_triplets:
+ * i valori con le stesse coordinate vengono sommati (richiede operator+=).
+ *
+ * @brief Fusione dei duplicati: somma
+ */
+struct merge_sum
+{
+  template <typename T>
+  void operator()(T &current, const T &incoming) const
+  {
+    current += incoming;
+  }
+};
+
+/**
+ * Politica di fusione dei duplicati per sparse_matrix::from_triplets:
+ * la presenza di due valori con le stesse coordinate e' un errore.
+ *
+ * @brief Fusione dei duplicati: errore
+ */
+struct merge_error
+{
+  template <typename T>
+  void operator()(T &, const T &) const
+  {
+    throw std::invalid_argument("sparse_matrix: coordinate duplicate");
+  }
+};
+
+template <typename T, typename E, typename A, typename I>
+class sparse_view; // forward declaration
 
 /**
  * Classe che implementa una matrice sparsa contenente dati generici di tipo T.
+ *
+ * Gli elementi inseriti sono memorizzati in tre array contigui e paralleli
+ * (indici di riga, indici di colonna e valori), mantenuti ordinati per
+ * (riga, colonna). L'i-esimo elemento della matrice e' quindi la terna
+ * (_row_idx[i], _col_idx[i], _values[i]).
  * 
  * @brief Matrice sparsa
  * 
  * @param T tipo del dato
  * @param E funtore di comparazione (==) di due dati di tipo T
+ * @param A allocatore usato per i valori e (tramite rebind) per gli indici
+ * @param I tipo intero senza segno degli indici di riga e colonna: a 16 bit
+ *          per blocchi piccoli, a 64 bit per dimensioni oltre 2^32
  */
-template <typename T, typename E>
+template <typename T, typename E, typename A = std::allocator<T>,
+          typename I = unsigned int>
 class sparse_matrix
 {
+  static_assert(std::is_integral<I>::value && std::is_unsigned<I>::value,
+                "sparse_matrix richiede indici interi senza segno");
+
 public:
   /**
-   * Struttura che implementa un singolo elemento della matrice, 
-   * memorizzando quindi la coppia (riga, colonna) e il valore
+   * Struttura che implementa la vista su un singolo elemento della matrice,
+   * esponendo quindi la coppia (riga, colonna) e un reference al valore
    * corrispondente a quella cella della matrice.
    * 
    * @brief Elemento della matrice
    */
   struct element
   {
-    T value;                ///< Dato inserito nella matrice
-    const unsigned int row; ///< Indice di riga dell'elemento
-    const unsigned int col; ///< Indice di colonna dell'elemento
+    T &value;               ///< Dato inserito nella matrice
+    const I row; ///< Indice di riga dell'elemento
+    const I col; ///< Indice di colonna dell'elemento
 
     /**
      * Costruttore primario che inizializza un elemento.
      * 
-     * @param val valore del dato
-     * @param r indice di riga del dato da inserire nella matrice
-     * @param c indice di colonna del dato da inserire nella matrice
+     * @param val reference al dato memorizzato nella matrice
+     * @param r indice di riga del dato
+     * @param c indice di colonna del dato
      */
-    element(const T &val, const unsigned int &r, const unsigned int &c)
+    element(T &val, const I &r, const I &c)
         : value(val), row(r), col(c) {}
 
     /**
@@ -47,38 +120,145 @@ public:
 
   }; // END struct element
 
+  /**
+   * Vista costante su un singolo elemento della matrice.
+   *
+   * @brief Elemento costante della matrice
+   */
+  struct const_element
+  {
+    const T &value;         ///< Dato inserito nella matrice
+    const I row; ///< Indice di riga dell'elemento
+    const I col; ///< Indice di colonna dell'elemento
+
+    /**
+     * Costruttore primario che inizializza un elemento costante.
+     *
+     * @param val reference al dato memorizzato nella matrice
+     * @param r indice di riga del dato
+     * @param c indice di colonna del dato
+     */
+    const_element(const T &val, const I &r, const I &c)
+        : value(val), row(r), col(c) {}
+
+    /**
+     * Costruttore di conversione da un elemento non costante.
+     *
+     * @param other elemento da convertire
+     */
+    const_element(const element &other)
+        : value(other.value), row(other.row), col(other.col) {}
+
+  }; // END struct const_element
+
+  /**
+   * Terna (valore, riga, colonna) usata per la costruzione in blocco
+   * della matrice con from_triplets().
+   *
+   * @brief Terna di coordinate e valore
+   */
+  struct triplet
+  {
+    T value;          ///< Dato da inserire nella matrice
+    I row; ///< Indice di riga del dato
+    I col; ///< Indice di colonna del dato
+
+    /**
+     * Costruttore primario che inizializza una terna.
+     *
+     * @param val valore del dato
+     * @param r indice di riga del dato
+     * @param c indice di colonna del dato
+     */
+    triplet(const T &val, const I &r, const I &c)
+        : value(val), row(r), col(c) {}
+
+  }; // END struct triplet
+
+  typedef A allocator_type;    ///< tipo dell'allocatore
+  typedef I index_type;        ///< tipo degli indici di riga e colonna
+  typedef std::size_t size_type; ///< tipo del numero di elementi
+
   /**
    * Costruttore primario che inizializza il valore di default della matrice.
    *
    * @param default_value valore di default della matrice
+   * @param alloc allocatore da cui prelevare la memoria degli array
+   */
+  sparse_matrix(const T &default_value, const A &alloc = A())
+      : _row_idx(nullptr), _col_idx(nullptr), _values(nullptr),
+        _default(default_value), _size(0), _capacity(0), _row_ptr(nullptr),
+        _indexed_rows(0), _nrows(0), _ncols(0), _fixed_shape(false),
+        _alloc(alloc) {}
+
+  /**
+   * Costruttore che dichiara esplicitamente le dimensioni della matrice.
+   * Le dimensioni restano fisse e l'inserimento di un elemento al di fuori
+   * di esse viene rifiutato.
+   *
+   * @param rows numero di righe della matrice
+   * @param cols numero di colonne della matrice
+   * @param default_value valore di default della matrice
+   * @param alloc allocatore da cui prelevare la memoria degli array
    */
-  sparse_matrix(const T &default_value)
-      : _elem(nullptr), _size(0), _default(default_value) {}
+  sparse_matrix(I rows, I cols, const T &default_value,
+                const A &alloc = A())
+      : _row_idx(nullptr), _col_idx(nullptr), _values(nullptr),
+        _default(default_value), _size(0), _capacity(0), _row_ptr(nullptr),
+        _indexed_rows(0), _nrows(rows), _ncols(cols), _fixed_shape(true),
+        _alloc(alloc) {}
 
   /**
    * Costruttore secondario.
    * 
    * Costruisce una matrice di tipo T partendo da una matrice di tipo Q. 
+   * La conversione avviene in un'unica passata lineare.
    * 
    * @param other_Q matrice sparsa di tipo Q 
+   * @param alloc allocatore da cui prelevare la memoria degli array
    * 
    * @throw eccezione di allocazione della memoria
    */
-  template <typename Q, typename F>
-  sparse_matrix(const sparse_matrix<Q, F> &other_Q)
-      : _elem(nullptr), _size(0)
+  template <typename Q, typename F, typename B, typename J>
+  sparse_matrix(const sparse_matrix<Q, F, B, J> &other_Q, const A &alloc = A())
+      : _row_idx(nullptr), _col_idx(nullptr), _values(nullptr), _size(0),
+        _capacity(0), _row_ptr(nullptr), _indexed_rows(0),
+        _nrows(other_Q.get_rows()), _ncols(other_Q.get_columns()),
+        _fixed_shape(other_Q.has_fixed_shape()), _alloc(alloc)
   {
     _default = other_Q.get_default();
-    typename sparse_matrix<Q, F>::const_iterator it, ite;
+    typename sparse_matrix<Q, F, B, J>::const_iterator it, ite;
 
     it = other_Q.begin();
     ite = other_Q.end();
 
+    /*
+    gli elementi di other_Q sono gia' ordinati e privi di duplicati, per cui
+    vengono accodati in un'unica passata, scartando solo quelli che dopo la
+    conversione risultano uguali al default.
+    */
     try
     {
+      reserve(other_Q.get_size());
+      if (!_fixed_shape)
+      {
+        _nrows = 0;
+        _ncols = 0;
+      }
+
       while (it != ite)
       {
-        add(it->value, it->row, it->col);
+        T value = it->value;
+        if (!equals_(value, _default))
+        {
+          append(std::move(value), it->row, it->col);
+          if (!_fixed_shape)
+          {
+            _nrows = it->row + 1;
+            if (it->col >= _ncols)
+              _ncols = it->col + 1;
+          }
+        }
         it++;
       }
     }
@@ -91,21 +271,41 @@ public:
 
   /**
    * Costruttore di copia.
+   * Gli array vengono allocati una sola volta della dimensione esatta e
+   * gli elementi copiati nell'ordine in cui si trovano, in tempo lineare.
    * 
    * @param other matrice da copiare 
    * 
    * @throw eccezione di allocazione della memoria
    */
-  sparse_matrix(const sparse_matrix &other) : _elem(nullptr), _size(0)
+  sparse_matrix(const sparse_matrix &other)
+      : sparse_matrix(other, alloc_traits::select_on_container_copy_construction(
+                                 other._alloc)) {}
+
+  /**
+   * Costruttore di copia con allocatore: gli elementi di other vengono
+   * copiati in array allocati con alloc.
+   *
+   * @param other matrice da copiare
+   * @param alloc allocatore della nuova matrice
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  sparse_matrix(const sparse_matrix &other, const A &alloc)
+      : _row_idx(nullptr), _col_idx(nullptr), _values(nullptr), _size(0),
+        _capacity(0), _row_ptr(nullptr), _indexed_rows(0),
+        _nrows(other._nrows), _ncols(other._ncols),
+        _fixed_shape(other._fixed_shape), equals_(other.equals_),
+        _alloc(alloc)
   {
     _default = other._default;
-    element **temp = other._elem;
 
     try
     {
-      for (int i = 0; i < other._size; ++i)
+      reserve(other._size);
+      for (std::size_t i = 0; i < other._size; ++i)
       {
-        add(temp[i]->value, temp[i]->row, temp[i]->col);
+        append(other._values[i], other._row_idx[i], other._col_idx[i]);
       }
     }
     catch (...)
@@ -116,7 +316,9 @@ public:
   }
 
   /**
-   * Operatore di assegnamento.
+   * Operatore di assegnamento. L'allocatore di other viene acquisito solo
+   * se propagate_on_container_copy_assignment lo prevede; altrimenti gli
+   * elementi vengono copiati negli array del proprio allocatore.
    * 
    * @param other matrice da copiare
    * @return reference a this
@@ -125,14 +327,15 @@ public:
    */
   sparse_matrix &operator=(const sparse_matrix &other)
   {
+    typedef typename alloc_traits::propagate_on_container_copy_assignment
+        propagate;
+
     try
     {
       if (this != &other)
       {
-        sparse_matrix tmp(other);
-        std::swap(_elem, tmp._elem);
-        std::swap(_size, tmp._size);
-        std::swap(_default, tmp._default);
+        sparse_matrix tmp(other, propagate::value ? other._alloc : _alloc);
+        adopt(tmp, propagate());
       }
     }
     catch (...)
@@ -144,149 +347,237 @@ public:
   }
 
   /**
-   * Distruttore.
+   * Costruttore di spostamento: acquisisce gli array di other senza copiare
+   * gli elementi. other resta una matrice vuota, il cui default e' stato
+   * spostato, che puo' essere distrutta o riassegnata.
+   *
+   * @param other matrice da spostare
    */
-  ~sparse_matrix()
+  sparse_matrix(sparse_matrix &&other) noexcept(
+      std::is_nothrow_move_constructible<T>::value &&
+      std::is_nothrow_copy_constructible<E>::value &&
+      std::is_nothrow_move_constructible<A>::value)
+      : _row_idx(other._row_idx), _col_idx(other._col_idx),
+        _values(other._values), _default(std::move(other._default)),
+        _size(other._size),
+        _capacity(other._capacity), _row_ptr(other._row_ptr),
+        _indexed_rows(other._indexed_rows), _nrows(other._nrows),
+        _ncols(other._ncols), _fixed_shape(other._fixed_shape),
+        equals_(other.equals_), _alloc(std::move(other._alloc))
   {
-    clear();
+    other.forget();
   }
 
   /**
-   * Ritorna il valore di default della matrice.
-   * 
-   * @return valore di default 
+   * Costruttore di spostamento con allocatore: se alloc e' uguale
+   * all'allocatore di other gli array vengono acquisiti senza copie,
+   * altrimenti gli elementi vengono spostati uno a uno in array allocati
+   * con alloc. In entrambi i casi other resta una matrice vuota.
+   *
+   * @param other matrice da spostare
+   * @param alloc allocatore della nuova matrice
+   *
+   * @throw eccezione di allocazione della memoria (solo con allocatori
+   *        diversi)
    */
-  T get_default() const { return _default; }
+  sparse_matrix(sparse_matrix &&other, const A &alloc)
+      : _row_idx(nullptr), _col_idx(nullptr), _values(nullptr),
+        _default(std::move(other._default)), _size(0), _capacity(0),
+        _row_ptr(nullptr), _indexed_rows(0), _nrows(other._nrows),
+        _ncols(other._ncols), _fixed_shape(other._fixed_shape),
+        equals_(other.equals_), _alloc(alloc)
+  {
+    if (_alloc == other._alloc)
+    {
+      _row_idx = other._row_idx;
+      _col_idx = other._col_idx;
+      _values = other._values;
+      _size = other._size;
+      _capacity = other._capacity;
+      _row_ptr = other._row_ptr;
+      _indexed_rows = other._indexed_rows;
+      other.forget();
+      return;
+    }
 
-  /**
-   * Imposta il valore di default.
-   * 
-   * @param default_value valore di default della matrice 
-   */
-  void set_default(const T &default_value) { _default = default_value; }
+    try
+    {
+      reserve(other._size);
+      for (std::size_t i = 0; i < other._size; ++i)
+        append(std::move(other._values[i]), other._row_idx[i],
+               other._col_idx[i]);
+    }
+    catch (...)
+    {
+      clear();
+      throw;
+    }
+    other.clear();
+  }
 
   /**
-   * Ritorna il numero di elementi inseriti nella matrice.
+   * Operatore di assegnamento per spostamento. Gli array di other vengono
+   * acquisiti senza copie se l'allocatore si propaga con lo spostamento
+   * (propagate_on_container_move_assignment) o se i due allocatori sono
+   * uguali; altrimenti gli elementi vengono spostati uno a uno negli array
+   * del proprio allocatore.
    *
-   * @return numero di elementi inseriti
+   * @param other matrice da spostare
+   * @return reference a this
+   *
+   * @throw eccezione di allocazione della memoria (solo con allocatori
+   *        diversi che non si propagano)
    */
-  unsigned int get_size() const { return _size; }
+  sparse_matrix &operator=(sparse_matrix &&other) noexcept(
+      std::is_nothrow_move_constructible<T>::value &&
+      std::is_nothrow_copy_constructible<E>::value &&
+      std::is_nothrow_move_constructible<A>::value &&
+      std::allocator_traits<A>::propagate_on_container_move_assignment::value)
+  {
+    typedef typename alloc_traits::propagate_on_container_move_assignment
+        propagate;
+
+    if (this != &other)
+    {
+      sparse_matrix tmp(std::move(other),
+                        propagate::value ? other._alloc : _alloc);
+      adopt(tmp, propagate());
+    }
+    return *this;
+  }
 
   /**
-   * Ritorna il numero di righe della matrice.
+   * Scambia il contenuto di due matrici. Se l'allocatore si propaga con lo
+   * scambio (propagate_on_container_swap) o i due allocatori sono uguali,
+   * lo scambio e' O(1); altrimenti ogni matrice sposta gli elementi
+   * dell'altra negli array del proprio allocatore, O(n).
    *
-   * @return numero di righe
+   * @param other matrice con cui scambiare il contenuto
+   *
+   * @throw eccezione di allocazione della memoria (solo con allocatori
+   *        diversi che non si propagano)
    */
-  unsigned int get_rows() const
+  void swap(sparse_matrix &other)
   {
-    if (_elem == nullptr)
-      return 0;
-    else
+    typedef typename alloc_traits::propagate_on_container_swap propagate;
+
+    if (propagate::value || _alloc == other._alloc)
     {
-      return (_elem[_size - 1]->row + 1);
+      swap_contents(other);
+      swap_allocators(other, propagate());
+      return;
     }
+
+    sparse_matrix mine(std::move(other), _alloc);
+    sparse_matrix theirs(std::move(*this), other._alloc);
+    swap_contents(mine);
+    other.swap_contents(theirs);
+  }
+
+  /**
+   * Distruttore.
+   */
+  ~sparse_matrix()
+  {
+    clear();
   }
 
   /**
-   * Ritorna il numero di colonne della matrice.
+   * Costruisce una matrice a partire da una sequenza non ordinata di terne
+   * (vedi assign_triplets()).
    *
-   * @return numero di colonne
+   * @param first iteratore alla prima terna
+   * @param last iteratore alla fine della sequenza di terne
+   * @param default_value valore di default della matrice
+   * @param merge funtore di fusione dei duplicati, merge(corrente, nuovo)
+   * @param alloc allocatore della matrice risultato
+   *
+   * @return matrice contenente le terne in input
+   *
+   * @throw eccezione di allocazione della memoria o lanciata da merge
    */
-  unsigned int get_columns() const
+  template <typename InputIt, typename M>
+  static sparse_matrix from_triplets(InputIt first, InputIt last,
+                                     const T &default_value, M merge,
+                                     const A &alloc = A())
   {
-    if (_elem == nullptr)
-      return 0;
-    else
-    {
-      int cols = 0;
-      for (int i = 0; i < _size; i++)
-      {
-        if (_elem[i]->col > cols)
-          cols = _elem[i]->col;
-      }
-      return cols + 1;
-    }
+    sparse_matrix m(default_value, alloc);
+    m.assign_triplets(first, last, merge);
+    return m;
   }
 
   /**
-   * Aggiunge un elemento nella matrice. 
-   * L'ordinamento viene effettuato mediante il metodo sort().
+   * Sostituisce il contenuto della matrice con una sequenza non ordinata
+   * di terne, mantenendo il default e le eventuali dimensioni fisse.
    *
-   * @param value valore da inserire
-   * @param row indice di riga dove inserire il valore
-   * @param col indice di colonna dove inserire il valore
+   * Gli elementi riferiti dagli iteratori devono esporre i membri value,
+   * row e col (ad esempio triplet, oppure gli elementi di un'altra
+   * sparse_matrix). Le terne vengono accodate senza controlli, ordinate una
+   * sola volta con sort() e poi compattate in un'unica passata lineare:
+   * i duplicati vengono fusi con la politica merge (merge_last, merge_sum,
+   * merge_error o un funtore analogo) e i valori uguali al default
+   * secondo E vengono scartati.
    *
-	 * @throw eccezione di allocazione della memoria
-	 */
-  void add(const T &value, const unsigned int &row, const unsigned int &col)
+   * @param first iteratore alla prima terna
+   * @param last iteratore alla fine della sequenza di terne
+   * @param merge funtore di fusione dei duplicati, merge(corrente, nuovo)
+   *
+   * @throw eccezione di allocazione della memoria o lanciata da merge
+   * @throw std::out_of_range se le dimensioni sono fisse e una terna e'
+   *        al di fuori della matrice
+   */
+  template <typename InputIt, typename M>
+  void assign_triplets(InputIt first, InputIt last, M merge)
   {
+    clear();
+
     try
     {
-      if (_elem == nullptr)
-      {
-        _size = 1;
-        _elem = new element *[_size];
-        _elem[0] = new element(value, row, col);
-      }
+      reserve_for(first, last,
+                  typename std::iterator_traits<InputIt>::iterator_category());
 
-      /* 
-      controllo nel caso in cui venga richiesto l'inserimento di un valore gia'
-      presente in corrispondenza della cella (row, col) in input, in tal caso
-      l'inserimento viene ignorato.
-      */
-      else if (equals_(value, this->operator()(row, col)))
-      {
-        return;
-      }
+      for (; first != last; ++first)
+        append(first->value, first->row, first->col);
 
-      /* 
-      controllo nel caso in cui vengo richiesto l'inserimento di un nuovo 
-      valore in una cella gia' occupata con un valore diverso da quello in input 
-      e dal valore di default. In tal caso viene sovrascritto il valore attuale
-      con quello nuovo.
-      */
-      else if (!equals_(_default, this->operator()(row, col)))
+      sort();
+
+      // fusione dei duplicati ed eliminazione dei valori di default
+      std::size_t w = 0;
+      I rows = 0;
+      I cols = 0;
+      for (std::size_t i = 0; i < _size;)
       {
-        for (int i = 0; i < _size; i++)
+        if (w != i)
         {
-          if (_elem[i]->row == row && _elem[i]->col == col)
-          {
-            _elem[i]->value = value;
-            return;
-          }
+          _values[w] = std::move(_values[i]);
+          _row_idx[w] = _row_idx[i];
+          _col_idx[w] = _col_idx[i];
         }
-      }
-
-      else
-      {
-        _size++;
-        // int new_size = _size + 1;
-        element **temp = new element *[_size];
 
-        for (int i = 0; i < _size - 1; i++)
-          temp[i] = _elem[i];
+        std::size_t j = i + 1;
+        for (; j < _size && _row_idx[j] == _row_idx[i] &&
+               _col_idx[j] == _col_idx[i];
+             j++)
+          merge(_values[w], _values[j]);
 
-        // deallocazione del puntatore per l'array precedente
-        delete[] _elem;
-        _elem = nullptr;
-
-        // reimposta il numero di elementi
-        // _size = new_size;
-
-        // riassegnamento puntatore al nuovo array
-        _elem = new element *[_size];
-        for (int i = 0; i < _size - 1; i++)
-          _elem[i] = temp[i];
-
-        // accoda il nuovo elemento
-        _elem[_size - 1] = new element(value, row, col);
+        if (!equals_(_values[w], _default))
+        {
+          check_bounds(_row_idx[w], _col_idx[w]);
+          rows = _row_idx[w] + 1;
+          if (_col_idx[w] >= cols)
+            cols = _col_idx[w] + 1;
+          w++;
+        }
+        i = j;
+      }
 
-        // deallocazione risorsa inutilizzata;
-        delete[] temp;
-        temp = nullptr;
+      destroy(_values + w, _size - w);
+      _size = w;
 
-        // ordinamento degli elementi in ordine crescente
-        sort();
+      if (!_fixed_shape)
+      {
+        _nrows = rows;
+        _ncols = cols;
       }
     }
     catch (...)
@@ -297,311 +588,2393 @@ public:
   }
 
   /**
-   * Operatore di lettura coordinate.
+   * Costruisce una matrice a partire da una sequenza non ordinata di terne;
+   * a parita' di coordinate vince l'ultimo valore.
    *
-   * @param row indice di riga
-   * @param col indice di colonna
-   * 
-   * @return valore dell'elemento corrispondente alle coordinate (row, col)
+   * @param first iteratore alla prima terna
+   * @param last iteratore alla fine della sequenza di terne
+   * @param default_value valore di default della matrice
+   *
+   * @return matrice contenente le terne in input
+   *
+   * @throw eccezione di allocazione della memoria
    */
-  T &operator()(const unsigned int row, const unsigned int col)
+  template <typename InputIt>
+  static sparse_matrix from_triplets(InputIt first, InputIt last,
+                                     const T &default_value)
   {
-    if (_elem == nullptr)
-      return _default;
-
-    for (int i = 0; i < _size; i++)
-    {
-      if (_elem[i]->row == row && _elem[i]->col == col)
-      {
-        return _elem[i]->value;
-      }
-    }
-    return _default;
+    return from_triplets(first, last, default_value, merge_last());
   }
 
   /**
-   * Cancella il contenuto della matrice.
+   * Costruisce una matrice a partire da un vettore non ordinato di terne.
+   *
+   * @param triplets terne da inserire
+   * @param default_value valore di default della matrice
+   * @param merge funtore di fusione dei duplicati
+   * @param alloc allocatore della matrice risultato
+   *
+   * @return matrice contenente le terne in input
+   *
+   * @throw eccezione di allocazione della memoria o lanciata da merge
    */
-  void clear()
+  template <typename M>
+  static sparse_matrix from_triplets(const std::vector<triplet> &triplets,
+                                     const T &default_value, M merge,
+                                     const A &alloc = A())
   {
-    for (int i = 0; i < _size; i++)
-    {
-      delete _elem[i];
-      _elem[i] = nullptr;
-    }
-    delete[] _elem;
-    _elem = nullptr;
-    _size = 0;
+    return from_triplets(triplets.begin(), triplets.end(), default_value,
+                         merge, alloc);
   }
 
   /**
-   * Stampa la matrice completa, compresi i valori di default, 
-   * utilizzando l'operator().
+   * Costruisce una matrice a partire da un vettore non ordinato di terne;
+   * a parita' di coordinate vince l'ultimo valore.
+   *
+   * @param triplets terne da inserire
+   * @param default_value valore di default della matrice
+   *
+   * @return matrice contenente le terne in input
+   *
+   * @throw eccezione di allocazione della memoria
    */
-  void show()
+  static sparse_matrix from_triplets(const std::vector<triplet> &triplets,
+                                     const T &default_value)
   {
-    for (int i = 0; i < this->get_rows(); i++)
-    {
-      std::cout << std::endl;
-      for (int j = 0; j < this->get_columns(); j++)
-        std::cout << this->operator()(i, j) << " | ";
-    }
-    std::cout << std::endl;
+    return from_triplets(triplets.begin(), triplets.end(), default_value,
+                         merge_last());
   }
 
-  class const_iterator; // forward declaration
+  /**
+   * Ritorna il valore di default della matrice.
+   * 
+   * @return valore di default 
+   */
+  T get_default() const { return _default; }
+
+  /**
+   * Ritorna una copia dell'allocatore della matrice.
+   *
+   * @return allocatore della matrice
+   */
+  A get_allocator() const { return _alloc; }
 
   /**
-   * Iteratore di tipo forward della matrice.
+   * Imposta il valore di default.
    * 
-   * @brief Iteratore di tipo forward della matrice
+   * @param default_value valore di default della matrice 
    */
+  void set_default(const T &default_value) { _default = default_value; }
 
-  class iterator
-  {
-  public:
-    typedef std::forward_iterator_tag iterator_category;
-    typedef ptrdiff_t difference_type;
-    typedef element *pointer;
-    typedef element &reference;
+  /**
+   * Ritorna il numero di elementi inseriti nella matrice.
+   *
+   * @return numero di elementi inseriti
+   */
+  std::size_t get_size() const { return _size; }
 
-    iterator() : _el(0) {}
+  /**
+   * Ritorna il numero di elementi che la matrice puo' contenere
+   * senza riallocare la memoria.
+   *
+   * @return capacita' della matrice
+   */
+  std::size_t get_capacity() const { return _capacity; }
 
-    iterator(const iterator &other) : _el(other._el) {}
+  /**
+   * Riserva la memoria per almeno nnz elementi, in modo che i successivi
+   * inserimenti fino a nnz elementi non richiedano riallocazioni.
+   * Se nnz non supera la capacita' attuale non viene eseguita alcuna
+   * operazione.
+   *
+   * @param nnz numero di elementi da riservare
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  void reserve(std::size_t nnz)
+  {
+    if (nnz > _capacity)
+      reallocate(nnz);
+  }
 
-    iterator &operator=(const iterator &other)
-    {
-      _el = other._el;
-      return *this;
-    }
+  /**
+   * Riduce la capacita' della matrice al numero di elementi inseriti,
+   * liberando la memoria in eccesso.
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  void shrink_to_fit()
+  {
+    if (_capacity == _size)
+      return;
 
-    ~iterator() {}
+    if (_size == 0)
+      clear();
+    else
+      reallocate(_size);
+  }
 
-    // Ritorna il dato riferito dall'iteratore (derefenziamento)
-    reference operator*() const { return **_el; }
+  /**
+   * Ritorna il numero di righe della matrice: quello dichiarato nel
+   * costruttore oppure, se le dimensioni non sono fisse, l'indice di riga
+   * massimo piu' uno. Il valore e' mantenuto ad ogni inserimento, O(1).
+   *
+   * @return numero di righe
+   */
+  I get_rows() const { return _nrows; }
 
-    // Ritorna il puntatore al dato riferito dall'iteratore
-    pointer operator->() const { return *_el; }
+  /**
+   * Ritorna il numero di colonne della matrice: quello dichiarato nel
+   * costruttore oppure, se le dimensioni non sono fisse, l'indice di colonna
+   * massimo piu' uno. Il valore e' mantenuto ad ogni inserimento, O(1).
+   *
+   * @return numero di colonne
+   */
+  I get_columns() const { return _ncols; }
+
+  /**
+   * Ritorna true se le dimensioni della matrice sono state dichiarate
+   * nel costruttore.
+   *
+   * @return true se le dimensioni sono fisse
+   */
+  bool has_fixed_shape() const { return _fixed_shape; }
+
+  /**
+   * Aggiunge un elemento nella matrice. 
+   * Il nuovo elemento viene inserito direttamente nella sua posizione
+   * ordinata, spostando di un posto gli elementi successivi.
+   * Quando gli array sono pieni la capacita' viene raddoppiata, per cui
+   * il costo di riallocazione e' costante in media per inserimento.
+   * Aggiungere il valore di default in una cella occupata ne rimuove
+   * l'elemento.
+   *
+   * @param value valore da inserire
+   * @param row indice di riga dove inserire il valore
+   * @param col indice di colonna dove inserire il valore
+   *
+	 * @throw eccezione di allocazione della memoria
+   * @throw std::out_of_range se le dimensioni sono fisse e (row, col) e'
+   *        al di fuori della matrice
+	 */
+  void add(const T &value, const I &row, const I &col)
+  {
+    put(value, row, col);
+  }
+
+  /**
+   * Aggiunge un elemento nella matrice spostandone il valore, senza copie.
+   *
+   * @param value valore da spostare nella matrice
+   * @param row indice di riga dove inserire il valore
+   * @param col indice di colonna dove inserire il valore
+   *
+   * @throw eccezione di allocazione della memoria
+   * @throw std::out_of_range se le dimensioni sono fisse e (row, col) e'
+   *        al di fuori della matrice
+   */
+  void add(T &&value, const I &row, const I &col)
+  {
+    put(std::move(value), row, col);
+  }
+
+  /**
+   * Funzione di comodo che costruisce un valore temporaneo a partire da
+   * args e lo aggiunge nella cella (row, col) per spostamento: equivale a
+   * add(T(args...), row, col). Non e' una costruzione sul posto, perche'
+   * il valore serve prima dell'inserimento per confrontarlo con il
+   * default e con quello gia' presente.
+   *
+   * @param row indice di riga dove inserire il valore
+   * @param col indice di colonna dove inserire il valore
+   * @param args argomenti del costruttore di T
+   *
+   * @throw eccezione di allocazione della memoria o lanciata da T
+   * @throw std::out_of_range se le dimensioni sono fisse e (row, col) e'
+   *        al di fuori della matrice
+   */
+  template <typename... Args>
+  void emplace(const I &row, const I &col,
+               Args &&... args)
+  {
+    put(T(std::forward<Args>(args)...), row, col);
+  }
+
+  /**
+   * Operatore di lettura coordinate.
+   * La ricerca e' binaria sugli elementi ordinati, O(log n), oppure
+   * limitata alla sola riga richiesta se e' presente l'indice di riga
+   * (vedi build_row_index()).
+   *
+   * @param row indice di riga
+   * @param col indice di colonna
+   * 
+   * @return valore dell'elemento corrispondente alle coordinate (row, col)
+   */
+  T &operator()(const I row, const I col)
+  {
+    std::size_t pos = lower_bound(row, col);
+    if (pos < _size && _row_idx[pos] == row && _col_idx[pos] == col)
+      return _values[pos];
+    return _default;
+  }
+
+  /**
+   * Operatore di lettura coordinate su una matrice costante.
+   *
+   * @param row indice di riga
+   * @param col indice di colonna
+   *
+   * @return valore dell'elemento corrispondente alle coordinate (row, col)
+   */
+  const T &operator()(const I row, const I col) const
+  {
+    std::size_t pos = lower_bound(row, col);
+    if (pos < _size && _row_idx[pos] == row && _col_idx[pos] == col)
+      return _values[pos];
+    return _default;
+  }
+
+  /**
+   * Costruisce l'indice di riga in stile CSR: per ogni riga r gli elementi
+   * sono nelle posizioni [offset(r), offset(r + 1)), per cui le letture con
+   * operator() cercano solo tra gli elementi della riga, O(log nnz_riga).
+   * L'indice viene scartato al primo inserimento di un nuovo elemento ed
+   * e' allocato, come gli array degli elementi, con l'allocatore della
+   * matrice.
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  void build_row_index()
+  {
+    std::size_t rows = get_rows();
+    offset_allocator offset_alloc(_alloc);
+    std::size_t *row_ptr = offset_traits::allocate(offset_alloc, rows + 1);
+
+    std::size_t k = 0;
+    for (std::size_t r = 0; r <= rows; r++)
+    {
+      while (k < _size && _row_idx[k] < r)
+        k++;
+      row_ptr[r] = k;
+    }
+
+    drop_row_index();
+    _row_ptr = row_ptr;
+    _indexed_rows = rows;
+  }
+
+  /**
+   * Ritorna true se l'indice di riga e' stato costruito ed e' valido.
+   *
+   * @return true se e' presente l'indice di riga
+   */
+  bool has_row_index() const { return _row_ptr != nullptr; }
+
+  /**
+   * Elimina l'indice di riga, se presente.
+   */
+  void drop_row_index()
+  {
+    if (_row_ptr != nullptr)
+    {
+      offset_allocator offset_alloc(_alloc);
+      offset_traits::deallocate(offset_alloc, _row_ptr, _indexed_rows + 1);
+    }
+    _row_ptr = nullptr;
+    _indexed_rows = 0;
+  }
+
+  /**
+   * Produce una copia immutabile della matrice in formato CSR, ottimizzata
+   * per la sola lettura (vedi csr_matrix). Gli elementi sono gia' ordinati,
+   * per cui la conversione e' una singola passata lineare.
+   *
+   * @return matrice CSR con gli stessi elementi, dimensioni e default
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  csr_matrix<T, E> freeze() const
+  {
+    static_assert(sizeof(I) <= sizeof(unsigned int),
+                  "sparse_matrix::freeze richiede indici di al piu' 32 bit");
+
+    std::vector<std::uint64_t> row_ptr(static_cast<std::size_t>(_nrows) + 1,
+                                       0);
+    for (std::size_t i = 0; i < _size; i++)
+      row_ptr[_row_idx[i] + 1]++;
+    for (I r = 0; r < _nrows; r++)
+      row_ptr[r + 1] += row_ptr[r];
+
+    std::vector<unsigned int> cols(_col_idx, _col_idx + _size);
+    std::vector<T> values(_values, _values + _size);
+
+    return csr_matrix<T, E>(_nrows, _ncols, _default, std::move(row_ptr),
+                            std::move(cols), std::move(values));
+  }
+
+  /**
+   * Produce una copia immutabile della matrice in formato CSC, con accesso
+   * O(1) alle colonne (vedi csc_matrix). Gli elementi vengono raggruppati
+   * per colonna con un counting sort, O(nnz + colonne).
+   *
+   * @return matrice CSC con gli stessi elementi, dimensioni e default
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  csc_matrix<T, E> freeze_csc() const
+  {
+    static_assert(sizeof(I) <= sizeof(unsigned int),
+                  "sparse_matrix::freeze_csc richiede indici di al piu' 32 bit");
+
+    std::vector<std::uint64_t> col_ptr;
+    std::vector<std::size_t> perm = column_order(col_ptr);
+
+    std::vector<unsigned int> rows(_size);
+    std::vector<T> values;
+    values.reserve(_size);
+    for (std::size_t i = 0; i < _size; i++)
+    {
+      rows[i] = _row_idx[perm[i]];
+      values.push_back(_values[perm[i]]);
+    }
+
+    return csc_matrix<T, E>(csr_matrix<T, E>(
+        _ncols, _nrows, _default, std::move(col_ptr), std::move(rows),
+        std::move(values)));
+  }
+
+  /**
+   * Produce una copia immutabile della matrice a blocchi densi B x B
+   * (vedi bsr_matrix). Gli elementi di un blocco-riga sono contigui, per
+   * cui ogni blocco-riga viene convertito con una sola visita dei suoi
+   * elementi, ordinandone solo gli indici di blocco-colonna distinti.
+   *
+   * @return matrice a blocchi con gli stessi elementi, dimensioni e default
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  template <unsigned int B>
+  bsr_matrix<T, E, B> freeze_bsr() const
+  {
+    static_assert(sizeof(I) <= sizeof(unsigned int),
+                  "sparse_matrix::freeze_bsr richiede indici di al piu' 32 bit");
+
+    const unsigned int nbr = (_nrows + B - 1) / B;
+    const unsigned int nbc = (_ncols + B - 1) / B;
+
+    // slot[bc]: blocco assegnato alla colonna di blocchi bc nel blocco-riga
+    // corrente, valido se mark[bc] vale il blocco-riga corrente + 1
+    std::vector<unsigned int> mark(nbc, 0);
+    std::vector<std::uint64_t> slot(nbc);
+    std::vector<std::uint64_t> row_ptr(static_cast<std::size_t>(nbr) + 1, 0);
+    std::vector<unsigned int> cols;
+    std::vector<T> values;
+
+    std::size_t k = 0;
+    for (unsigned int br = 0; br < nbr; br++)
+    {
+      const std::size_t first = k;
+      const std::uint64_t base = cols.size();
+      for (; k < _size && _row_idx[k] / B == br; k++)
+      {
+        unsigned int bc = _col_idx[k] / B;
+        if (mark[bc] != br + 1)
+        {
+          mark[bc] = br + 1;
+          cols.push_back(bc);
+        }
+      }
+      std::sort(cols.begin() + base, cols.end());
+      for (std::uint64_t q = base; q < cols.size(); q++)
+        slot[cols[q]] = q;
+
+      values.resize(cols.size() * B * B, _default);
+      for (std::size_t i = first; i < k; i++)
+        values[slot[_col_idx[i] / B] * B * B + (_row_idx[i] % B) * B +
+               _col_idx[i] % B] = _values[i];
+      row_ptr[br + 1] = cols.size();
+    }
+
+    return bsr_matrix<T, E, B>(_nrows, _ncols, _default, std::move(row_ptr),
+                               std::move(cols), std::move(values));
+  }
+
+  /**
+   * Ritorna la trasposta della matrice. Gli elementi vengono raggruppati
+   * per colonna con un counting sort, per cui la trasposta e' gia' ordinata
+   * e viene costruita in tempo O(nnz + colonne), senza ricerche. Se le
+   * colonne sono piu' degli elementi si usa invece un ordinamento stabile
+   * per confronto, O(nnz log nnz).
+   *
+   * @return matrice trasposta, con lo stesso default e allocatore
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  sparse_matrix transpose() const
+  {
+    std::vector<std::size_t> perm;
+    if (_ncols > _size)
+    {
+      perm.resize(_size);
+      for (std::size_t i = 0; i < _size; i++)
+        perm[i] = i;
+      std::stable_sort(perm.begin(), perm.end(),
+                       [this](std::size_t a, std::size_t b) {
+                         return _col_idx[a] < _col_idx[b];
+                       });
+    }
+    else
+    {
+      std::vector<std::uint64_t> col_ptr;
+      perm = column_order(col_ptr);
+    }
+
+    sparse_matrix t(_default, _alloc);
+    t.equals_ = equals_;
+    t.reserve(_size);
+    for (std::size_t i = 0; i < _size; i++)
+      t.append(_values[perm[i]], _col_idx[perm[i]], _row_idx[perm[i]]);
+
+    t._nrows = _ncols;
+    t._ncols = _nrows;
+    t._fixed_shape = _fixed_shape;
+    return t;
+  }
+
+  /**
+   * Prodotto matrice-vettore y = M * x (SpMV), per T aritmetico.
+   *
+   * Le celle implicite valgono il default d, per cui ogni riga vale
+   * y[i] = d * sum(x) + sum_j (M(i, j) - d) * x[j], dove la seconda somma
+   * scorre solo gli elementi inseriti. Gli elementi sono letti in ordine,
+   * riga per riga, accumulando ogni riga in una variabile locale; per
+   * float, double, int32 e int64 il prodotto di riga usa i kernel
+   * vettoriali di sparse_kernels supportati dalla CPU.
+   *
+   * @param x vettore di get_columns() elementi
+   * @param y vettore di get_rows() elementi in cui scrivere il risultato
+   */
+  void multiply(const T *x, T *y) const
+  {
+    static_assert(std::is_arithmetic<T>::value,
+                  "sparse_matrix::multiply richiede un tipo aritmetico");
+
+    multiply_rows(x, y, _default * kernels::sum(x, _ncols), 0, _nrows, 0,
+                  row_kernels::row_dot());
+  }
+
+  /**
+   * Prodotto matrice-vettore y = M * x (SpMV) eseguito in parallelo.
+   *
+   * Le righe vengono divise in blocchi contigui con circa lo stesso numero
+   * di elementi inseriti (non di righe), in modo che poche righe molto
+   * dense non sbilancino il carico; ogni thread scrive solo le righe del
+   * proprio blocco di y. Una singola riga non viene mai divisa.
+   *
+   * @param x vettore di get_columns() elementi
+   * @param y vettore di get_rows() elementi in cui scrivere il risultato
+   * @param threads numero di thread da usare (0 = thread hardware)
+   *
+   * @throw std::system_error se non e' possibile creare un thread
+   */
+  void multiply(const T *x, T *y, unsigned int threads) const
+  {
+    static_assert(std::is_arithmetic<T>::value,
+                  "sparse_matrix::multiply richiede un tipo aritmetico");
+
+    std::vector<I> bounds = partition_rows(threads);
+    const T base = _default * kernels::sum(x, _ncols);
+    const typename row_kernels::row_dot_fn dot = row_kernels::row_dot();
+
+    sparse_kernels::run_parallel(bounds.size() - 1, [&](unsigned int t) {
+      multiply_rows(x, y, base, bounds[t], bounds[t + 1],
+                    lower_bound(bounds[t], 0), dot);
+    });
+  }
+
+  /**
+   * Prodotto matrice-vettore y = M * x (SpMV), per T aritmetico.
+   *
+   * @param x vettore di get_columns() elementi
+   *
+   * @return vettore di get_rows() elementi con il risultato
+   *
+   * @throw std::invalid_argument se x non ha get_columns() elementi
+   */
+  std::vector<T> multiply(const std::vector<T> &x) const
+  {
+    if (x.size() != _ncols)
+      throw std::invalid_argument("sparse_matrix: dimensione di x errata");
+
+    std::vector<T> y(_nrows);
+    multiply(x.data(), y.data());
+    return y;
+  }
+
+  /**
+   * Prodotto matrice-vettore y = M * x (SpMV) eseguito in parallelo.
+   *
+   * @param x vettore di get_columns() elementi
+   * @param threads numero di thread da usare (0 = thread hardware)
+   *
+   * @return vettore di get_rows() elementi con il risultato
+   *
+   * @throw std::invalid_argument se x non ha get_columns() elementi
+   * @throw std::system_error se non e' possibile creare un thread
+   */
+  std::vector<T> multiply(const std::vector<T> &x, unsigned int threads) const
+  {
+    if (x.size() != _ncols)
+      throw std::invalid_argument("sparse_matrix: dimensione di x errata");
+
+    std::vector<T> y(_nrows);
+    multiply(x.data(), y.data(), threads);
+    return y;
+  }
+
+  /**
+   * Prodotto matrice-matrice C = M * other (SpGEMM), per T aritmetico.
+   *
+   * Il calcolo procede in due fasi sulle righe di M: una fase simbolica
+   * che conta, per ogni riga di C, le colonne che possono essere non di
+   * default e una fase numerica che accumula i prodotti della riga in un
+   * accumulatore denso indicizzato per colonna. Entrambe le fasi possono
+   * essere divise tra piu' thread con gli stessi blocchi di righe di
+   * multiply(x, y, threads).
+   *
+   * I default vengono rispettati: scrivendo M = dA + A' e other = dB + B',
+   * dove A' e B' contengono le sole differenze dal default degli elementi
+   * inseriti, si ha
+   * C(i, j) = K * dA * dB + (A' B')(i, j) + dB * sum_k A'(i, k)
+   *           + dA * sum_k B'(k, j),
+   * con K dimensione comune. Il default di C e' K * dA * dB e vengono
+   * memorizzati solo i valori diversi da esso secondo E; con default non
+   * nulli C puo' quindi avere righe o colonne dense.
+   *
+   * C ha get_rows() righe e other.get_columns() colonne ed ha dimensioni
+   * fisse se le hanno entrambe le matrici.
+   *
+   * @param other matrice per cui moltiplicare
+   * @param threads numero di thread da usare (0 = thread hardware)
+   *
+   * @return matrice prodotto
+   *
+   * @throw std::invalid_argument se le matrici hanno dimensioni fisse
+   *        incompatibili
+   * @throw eccezione di allocazione della memoria
+   */
+  sparse_matrix multiply(const sparse_matrix &other,
+                         unsigned int threads = 1) const
+  {
+    static_assert(std::is_arithmetic<T>::value,
+                  "sparse_matrix::multiply richiede un tipo aritmetico");
+
+    if (_fixed_shape && other._fixed_shape && _ncols != other._nrows)
+      throw std::invalid_argument("sparse_matrix: dimensioni incompatibili");
+
+    spgemm_context ctx(*this, other);
+
+    // fase simbolica: numero massimo di elementi per riga di C
+    std::vector<I> bounds = partition_rows(threads);
+    std::vector<std::size_t> offsets(_nrows + 1, 0);
+
+    sparse_kernels::run_parallel(bounds.size() - 1, [&](unsigned int t) {
+      spgemm_workspace ws(ctx.ncols);
+      std::size_t k = lower_bound(bounds[t], 0);
+      for (I r = bounds[t]; r < bounds[t + 1]; r++)
+        offsets[r + 1] = spgemm_row(ctx, r, k, ws, false);
+    });
+
+    for (I r = 0; r < _nrows; r++)
+      offsets[r + 1] += offsets[r];
+
+    // fase numerica: valori della riga, scartando quelli di default
+    std::vector<T> values(offsets[_nrows]);
+    std::vector<I> cols(offsets[_nrows]);
+    std::vector<std::size_t> kept(_nrows, 0);
+
+    sparse_kernels::run_parallel(bounds.size() - 1, [&](unsigned int t) {
+      spgemm_workspace ws(ctx.ncols);
+      std::size_t k = lower_bound(bounds[t], 0);
+      for (I r = bounds[t]; r < bounds[t + 1]; r++)
+      {
+        spgemm_row(ctx, r, k, ws, true);
+        kept[r] = spgemm_store(ctx, r, ws, values.data() + offsets[r],
+                               cols.data() + offsets[r]);
+      }
+    });
+
+    // compattazione delle righe nella matrice risultato
+    sparse_matrix c(ctx.dc, _alloc);
+    std::size_t total = 0;
+    for (I r = 0; r < _nrows; r++)
+      total += kept[r];
+    c.reserve(total);
+
+    for (I r = 0; r < _nrows; r++)
+    {
+      for (std::size_t q = offsets[r]; q < offsets[r] + kept[r]; q++)
+        c.append(values[q], r, cols[q]);
+    }
+
+    c._nrows = _nrows;
+    c._ncols = ctx.ncols;
+    c._fixed_shape = _fixed_shape && other._fixed_shape;
+    return c;
+  }
+
+  /**
+   * Somma di tutti i valori della matrice, compresi i default, per T
+   * aritmetico. Per float, double, int32 e int64 la riduzione e' vettoriale.
+   *
+   * @return somma dei valori della matrice
+   */
+  T sum() const
+  {
+    static_assert(std::is_arithmetic<T>::value,
+                  "sparse_matrix::sum richiede un tipo aritmetico");
+
+    std::uint64_t defaults =
+        static_cast<std::uint64_t>(_nrows) * _ncols - _size;
+    return kernels::sum(_values, _size) + _default * static_cast<T>(defaults);
+  }
+
+  /**
+   * Conta le celle della matrice, compresi i default, il cui valore v
+   * soddisfa cmp(v, value). Con std::less, std::equal_to e std::greater
+   * e T float, double, int32 o int64 il conteggio e' vettoriale; ogni
+   * altro funtore binario viene valutato elemento per elemento.
+   *
+   * @param cmp funtore di confronto binario
+   * @param value secondo operando del confronto
+   *
+   * @return numero di celle che soddisfano il confronto
+   */
+  template <typename C>
+  std::uint64_t count_if(C cmp, const T &value) const
+  {
+    std::uint64_t n = kernels::count(_values, _size, cmp, value);
+    if (cmp(_default, value))
+      n += static_cast<std::uint64_t>(_nrows) * _ncols - _size;
+    return n;
+  }
+
+  /**
+   * Conta gli elementi inseriti (esclusi i default impliciti) il cui valore
+   * soddisfa pred, dividendo gli elementi in threads intervalli contigui
+   * della stessa lunghezza, contati in parallelo con contatori separati.
+   *
+   * @param pred predicato unario sui valori, invocato in modo concorrente
+   * @param threads numero di thread da usare (0 = thread hardware)
+   *
+   * @return numero di elementi inseriti che soddisfano pred
+   *
+   * @throw std::system_error se non e' possibile creare un thread
+   */
+  template <typename P>
+  std::uint64_t count_stored(P pred, unsigned int threads = 1) const
+  {
+    if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    if (threads > _size)
+      threads = static_cast<unsigned int>(std::max<std::size_t>(1, _size));
+
+    // contatori distanziati di una linea di cache contro il false sharing
+    struct counter
+    {
+      std::uint64_t n;
+      char pad[64 - sizeof(std::uint64_t)];
+    };
+    std::vector<counter> counts(threads);
+
+    sparse_kernels::run_parallel(threads, [&](unsigned int t) {
+      const std::size_t first = _size * t / threads;
+      const std::size_t last = _size * (t + 1) / threads;
+      P p(pred);
+      std::uint64_t n = 0;
+      for (std::size_t i = first; i < last; i++)
+        if (p(static_cast<const T &>(_values[i])))
+          n++;
+      counts[t].n = n;
+    });
+
+    std::uint64_t n = 0;
+    for (unsigned int t = 0; t < threads; t++)
+      n += counts[t].n;
+    return n;
+  }
+
+  /**
+   * Cancella il contenuto della matrice.
+   */
+  void clear()
+  {
+    release(_row_idx, _col_idx, _values, _size, _capacity);
+    _values = nullptr;
+    _row_idx = nullptr;
+    _col_idx = nullptr;
+    _size = 0;
+    _capacity = 0;
+    drop_row_index();
+
+    if (!_fixed_shape)
+    {
+      _nrows = 0;
+      _ncols = 0;
+    }
+  }
+
+  /**
+   * Rimuove l'elemento (row, col), se presente. La cella torna ad avere il
+   * valore di default. Gli elementi successivi vengono spostati di un posto,
+   * O(n) nel caso peggiore.
+   *
+   * @param row indice di riga
+   * @param col indice di colonna
+   *
+   * @return true se l'elemento era presente ed e' stato rimosso
+   */
+  bool erase(const I row, const I col)
+  {
+    std::size_t pos = lower_bound(row, col);
+    if (pos < _size && _row_idx[pos] == row && _col_idx[pos] == col)
+    {
+      erase_at(pos);
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * Rimuove tutti gli elementi il cui valore soddisfa il predicato pred,
+   * con un'unica passata lineare di compattazione.
+   *
+   * @param pred predicato unario sui valori della matrice
+   *
+   * @return numero di elementi rimossi
+   *
+   * @throw eccezione lanciata da pred
+   */
+  template <typename P>
+  std::size_t erase_if(P pred)
+  {
+    std::size_t w = 0;
+    for (std::size_t i = 0; i < _size; i++)
+    {
+      if (pred(static_cast<const T &>(_values[i])))
+        continue;
+      if (w != i)
+      {
+        _values[w] = std::move(_values[i]);
+        _row_idx[w] = _row_idx[i];
+        _col_idx[w] = _col_idx[i];
+      }
+      w++;
+    }
+
+    std::size_t removed = _size - w;
+    if (removed > 0)
+    {
+      destroy(_values + w, removed);
+      _size = w;
+      drop_row_index();
+      shrink_shape();
+    }
+    return removed;
+  }
+
+  /**
+   * Rimuove gli elementi il cui valore e' uguale al default secondo E,
+   * ad esempio dopo averli azzerati tramite iteratore o operator().
+   *
+   * @return numero di elementi rimossi
+   */
+  std::size_t prune()
+  {
+    E equals(equals_);
+    const T &def = _default;
+    return erase_if([&](const T &value) { return equals(value, def); });
+  }
+
+  /**
+   * Stampa la matrice completa, compresi i valori di default.
+   * Gli elementi ordinati vengono visitati una sola volta e i default
+   * vengono inseriti per differenza tra le colonne di due elementi
+   * consecutivi, O(celle stampate + log n per riga), con l'output
+   * accumulato in un buffer (vedi sparse_format::writer).
+   *
+   * @param out stream di output
+   * @param opt finestra di righe e colonne da stampare e formato
+   *            (griglia, CSV o TSV)
+   */
+  void show(std::ostream &out = std::cout,
+            const sparse_format::print_options &opt =
+                sparse_format::print_options()) const
+  {
+    const std::uint64_t rows = this->get_rows();
+    const std::uint64_t cols = this->get_columns();
+    const std::uint64_t r0 = std::min(opt.first_row, rows);
+    const std::uint64_t r1 = r0 + std::min(opt.rows, rows - r0);
+    const std::uint64_t c0 = std::min(opt.first_col, cols);
+    const std::uint64_t c1 = c0 + std::min(opt.cols, cols - c0);
+    const bool grid = opt.format == sparse_format::grid;
+    const char sep = opt.format == sparse_format::csv ? ',' : '\t';
+
+    sparse_format::writer w(out);
+    for (std::uint64_t r = r0; r < r1; r++)
+    {
+      if (grid)
+        w.put('\n');
+
+      std::size_t pos = lower_bound(static_cast<I>(r), static_cast<I>(c0));
+      for (std::uint64_t c = c0; c < c1; c++)
+      {
+        if (pos < _size && _row_idx[pos] == r && _col_idx[pos] == c)
+          w.value(_values[pos++]);
+        else
+          w.value(_default);
+
+        if (grid)
+          w.text(" | ", 3);
+        else if (c + 1 < c1)
+          w.put(sep);
+      }
+
+      if (!grid)
+        w.put('\n');
+    }
+    if (grid)
+      w.put('\n');
+    w.flush();
+    out.flush();
+  }
+
+  class const_iterator; // forward declaration
+
+  /**
+   * Proxy restituito da operator-> degli iteratori: conserva la vista
+   * sull'elemento corrente e ne espone l'indirizzo.
+   *
+   * @brief Proxy per l'accesso ai membri di un elemento
+   */
+  template <typename V>
+  class arrow_proxy
+  {
+  public:
+    arrow_proxy(const V &v) : _v(v) {}
+
+    const V *operator->() const { return &_v; }
+
+  private:
+    V _v;
+  }; // END class arrow_proxy
+
+  /**
+   * Iteratore ad accesso casuale della matrice: gli elementi sono in array
+   * contigui, per cui avanzamento, distanza e confronto sono O(1) e gli
+   * algoritmi della libreria standard (anche paralleli) possono dividere
+   * un intervallo senza visitarlo. Il dereferenziamento ritorna per
+   * valore un element che riferisce il dato.
+   * 
+   * @brief Iteratore ad accesso casuale della matrice
+   */
+
+  class iterator
+  {
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef element value_type;
+    typedef ptrdiff_t difference_type;
+    typedef arrow_proxy<element> pointer;
+    typedef element reference;
+
+    iterator() : _val(0), _row(0), _col(0) {}
+
+    iterator(const iterator &other)
+        : _val(other._val), _row(other._row), _col(other._col) {}
+
+    iterator &operator=(const iterator &other)
+    {
+      _val = other._val;
+      _row = other._row;
+      _col = other._col;
+      return *this;
+    }
+
+    ~iterator() {}
+
+    // Ritorna il dato riferito dall'iteratore (derefenziamento)
+    reference operator*() const { return element(*_val, *_row, *_col); }
+
+    // Ritorna il puntatore al dato riferito dall'iteratore
+    pointer operator->() const { return pointer(**this); }
 
     // Operatore di iterazione post-incremento
     iterator operator++(int)
     {
-      iterator temp(*this);
-      _el = ++_el;
-      return temp;
+      iterator temp(*this);
+      ++(*this);
+      return temp;
+    }
+
+    // Operatore di iterazione pre-incremento
+    iterator &operator++()
+    {
+      ++_val;
+      ++_row;
+      ++_col;
+      return *this;
+    }
+
+    // Operatore di iterazione pre-decremento
+    iterator &operator--()
+    {
+      --_val;
+      --_row;
+      --_col;
+      return *this;
+    }
+
+    // Operatore di iterazione post-decremento
+    iterator operator--(int)
+    {
+      iterator temp(*this);
+      --(*this);
+      return temp;
+    }
+
+    // Avanzamento di n elementi, O(1)
+    iterator &operator+=(difference_type n)
+    {
+      _val += n;
+      _row += n;
+      _col += n;
+      return *this;
+    }
+
+    // Arretramento di n elementi, O(1)
+    iterator &operator-=(difference_type n) { return *this += -n; }
+
+    iterator operator+(difference_type n) const
+    {
+      iterator temp(*this);
+      return temp += n;
+    }
+
+    friend iterator operator+(difference_type n, const iterator &it)
+    {
+      return it + n;
+    }
+
+    iterator operator-(difference_type n) const
+    {
+      iterator temp(*this);
+      return temp -= n;
+    }
+
+    // Distanza tra due iteratori, O(1)
+    difference_type operator-(const iterator &other) const
+    {
+      return _val - other._val;
+    }
+
+    // Accesso all'elemento a distanza n
+    reference operator[](difference_type n) const { return *(*this + n); }
+
+    // Ordinamento per posizione
+    bool operator<(const iterator &other) const
+    {
+      return _val < other._val;
+    }
+
+    bool operator>(const iterator &other) const
+    {
+      return _val > other._val;
+    }
+
+    bool operator<=(const iterator &other) const
+    {
+      return _val <= other._val;
+    }
+
+    bool operator>=(const iterator &other) const
+    {
+      return _val >= other._val;
+    }
+
+    // Uguaglianza
+    bool operator==(const iterator &other) const { return (_val == other._val); }
+
+    // Diversita'
+    bool operator!=(const iterator &other) const { return (_val != other._val); }
+
+    friend class const_iterator;
+
+    // Uguaglianza con un const_iterator
+    bool operator==(const const_iterator &other) const
+    {
+      return (_val == other._val);
+    }
+
+    // Diversita' con un const_iterator
+    bool operator!=(const const_iterator &other) const
+    {
+      return (_val != other._val);
+    }
+
+  private:
+    T *_val;                   // posizione corrente nell'array dei valori
+    const I *_row;  // posizione corrente nell'array delle righe
+    const I *_col;  // posizione corrente nell'array delle colonne
+
+    // Classe container
+    friend class sparse_matrix;
+
+    // Costruttore privato di inizializzazione usato dalla classe container
+    iterator(T *val, const I *row, const I *col)
+        : _val(val), _row(row), _col(col) {}
+
+  }; // END class iterator
+
+  /**
+   * Ritorna l'iteratore al primo elemento della matrice.
+   *
+   * @return iteratore al primo elemento della matrice
+   */
+  iterator begin() { return iterator(_values, _row_idx, _col_idx); }
+
+  /**
+   * Ritorna l'iteratore all'ultimo elemento della matrice.
+   *
+   * @return iteratore all'ultimo elemento della matrice
+   */
+  iterator end()
+  {
+    return iterator(_values + _size, _row_idx + _size, _col_idx + _size);
+  }
+
+  /**
+   * Rimuove l'elemento riferito dall'iteratore it.
+   *
+   * @param it iteratore a un elemento della matrice (diverso da end())
+   *
+   * @return iteratore all'elemento che seguiva quello rimosso
+   */
+  iterator erase(iterator it)
+  {
+    std::size_t pos = static_cast<std::size_t>(it._val - _values);
+    erase_at(pos);
+    return iterator(_values + pos, _row_idx + pos, _col_idx + pos);
+  }
+
+  /**
+   * Iteratore costante ad accesso casuale della matrice.
+   * 
+   * @brief Iteratore costante della matrice
+   */
+
+  class const_iterator
+  {
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef const_element value_type;
+    typedef ptrdiff_t difference_type;
+    typedef arrow_proxy<const_element> pointer;
+    typedef const_element reference;
+
+    const_iterator() : _val(0), _row(0), _col(0) {}
+
+    const_iterator(const const_iterator &other)
+        : _val(other._val), _row(other._row), _col(other._col) {}
+
+    const_iterator &operator=(const const_iterator &other)
+    {
+      _val = other._val;
+      _row = other._row;
+      _col = other._col;
+      return *this;
+    }
+
+    ~const_iterator() {}
+
+    // Ritorna il dato riferito dall'iteratore (dereferenziamento)
+    reference operator*() const { return const_element(*_val, *_row, *_col); }
+
+    // Ritorna il puntatore al dato riferito dall'iteratore
+    pointer operator->() const { return pointer(**this); }
+
+    // Operatore di iterazione post-incremento
+    const_iterator operator++(int)
+    {
+      const_iterator temp(*this);
+      ++(*this);
+      return temp;
+    }
+    // Operatore di iterazione pre-incremento
+    const_iterator &operator++()
+    {
+      ++_val;
+      ++_row;
+      ++_col;
+      return *this;
+    }
+
+    // Operatore di iterazione pre-decremento
+    const_iterator &operator--()
+    {
+      --_val;
+      --_row;
+      --_col;
+      return *this;
+    }
+
+    // Operatore di iterazione post-decremento
+    const_iterator operator--(int)
+    {
+      const_iterator temp(*this);
+      --(*this);
+      return temp;
+    }
+
+    // Avanzamento di n elementi, O(1)
+    const_iterator &operator+=(difference_type n)
+    {
+      _val += n;
+      _row += n;
+      _col += n;
+      return *this;
+    }
+
+    // Arretramento di n elementi, O(1)
+    const_iterator &operator-=(difference_type n) { return *this += -n; }
+
+    const_iterator operator+(difference_type n) const
+    {
+      const_iterator temp(*this);
+      return temp += n;
+    }
+
+    friend const_iterator operator+(difference_type n, const const_iterator &it)
+    {
+      return it + n;
+    }
+
+    const_iterator operator-(difference_type n) const
+    {
+      const_iterator temp(*this);
+      return temp -= n;
+    }
+
+    // Distanza tra due iteratori, O(1)
+    difference_type operator-(const const_iterator &other) const
+    {
+      return _val - other._val;
+    }
+
+    // Accesso all'elemento a distanza n
+    reference operator[](difference_type n) const { return *(*this + n); }
+
+    // Ordinamento per posizione
+    bool operator<(const const_iterator &other) const
+    {
+      return _val < other._val;
+    }
+
+    bool operator>(const const_iterator &other) const
+    {
+      return _val > other._val;
+    }
+
+    bool operator<=(const const_iterator &other) const
+    {
+      return _val <= other._val;
+    }
+
+    bool operator>=(const const_iterator &other) const
+    {
+      return _val >= other._val;
+    }
+
+    // Uguaglianza
+    bool operator==(const const_iterator &other) const
+    {
+      return (_val == other._val);
+    }
+
+    // Diversita'
+    bool operator!=(const const_iterator &other) const
+    {
+      return (_val != other._val);
+    }
+
+    friend class iterator;
+
+    // Uguaglianza con un iterator
+    bool operator==(const iterator &other) const
+    {
+      return (_val == other._val);
+    }
+
+    // Diversita' con un iterator
+    bool operator!=(const iterator &other) const
+    {
+      return (_val != other._val);
+    }
+
+    // Costruttore di conversione
+    const_iterator(const iterator &other)
+        : _val(other._val), _row(other._row), _col(other._col) {}
+
+    // Operatore di assegnamento
+    const_iterator &operator=(const iterator &other)
+    {
+      _val = other._val;
+      _row = other._row;
+      _col = other._col;
+      return *this;
+    }
+
+  private:
+    const T *_val;             // posizione corrente nell'array dei valori
+    const I *_row;  // posizione corrente nell'array delle righe
+    const I *_col;  // posizione corrente nell'array delle colonne
+
+    // Classe container
+    friend class sparse_matrix;
+
+    // Costruttore privato di inizializzazione usato dalla classe container
+    const_iterator(const T *val, const I *row,
+                   const I *col)
+        : _val(val), _row(row), _col(col) {}
+
+  }; // END class const_iterator
+
+  /**
+   * Ritorna l'iteratore al primo elemento della matrice.
+   * 
+   * @return iteratore al primo elemento della matrice
+	*/
+  const_iterator begin() const
+  {
+    return const_iterator(_values, _row_idx, _col_idx);
+  }
+
+  /**
+   * Ritorna l'iteratore all'ultimo elemento della matrice.
+   * 
+   * @return iteratore all'ultimo elemento della matrice
+	*/
+  const_iterator end() const
+  {
+    return const_iterator(_values + _size, _row_idx + _size, _col_idx + _size);
+  }
+
+  /**
+   * Ritorna l'iteratore al primo elemento della riga row: gli elementi
+   * della riga sono contigui, per cui [row_begin(row), row_end(row))
+   * visita le coppie (colonna, valore) della riga in ordine di colonna.
+   * O(log n), oppure O(log elementi della riga) con l'indice di riga.
+   *
+   * @param row indice di riga
+   * @return iteratore al primo elemento della riga
+   */
+  const_iterator row_begin(const I row) const
+  {
+    return begin() + static_cast<std::ptrdiff_t>(lower_bound(row, 0));
+  }
+
+  /**
+   * Ritorna l'iteratore alla fine della riga row.
+   *
+   * @param row indice di riga
+   * @return iteratore all'elemento successivo all'ultimo della riga
+   */
+  const_iterator row_end(const I row) const
+  {
+    return begin() + static_cast<std::ptrdiff_t>(row_limit(row));
+  }
+
+  /**
+   * Ritorna l'iteratore modificabile al primo elemento della riga row.
+   *
+   * @param row indice di riga
+   * @return iteratore al primo elemento della riga
+   */
+  iterator row_begin(const I row)
+  {
+    return begin() + static_cast<std::ptrdiff_t>(lower_bound(row, 0));
+  }
+
+  /**
+   * Ritorna l'iteratore modificabile alla fine della riga row.
+   *
+   * @param row indice di riga
+   * @return iteratore all'elemento successivo all'ultimo della riga
+   */
+  iterator row_end(const I row)
+  {
+    return begin() + static_cast<std::ptrdiff_t>(row_limit(row));
+  }
+
+  /**
+   * Verifica che (row, col) siano indici utilizzabili: il valore massimo
+   * di I e' riservato, perche' le dimensioni della matrice sono indice + 1.
+   * Usata anche dai formati che costruiscono una sparse_matrix (vedi
+   * hash_matrix), cosi' che l'errore emerga all'inserimento.
+   *
+   * @param row indice di riga
+   * @param col indice di colonna
+   *
+   * @throw std::out_of_range se row o col valgono
+   *        std::numeric_limits<I>::max()
+   */
+  static void check_index(I row, I col)
+  {
+    const I last = std::numeric_limits<I>::max();
+    if (row == last || col == last)
+      throw std::out_of_range("sparse_matrix: indice non rappresentabile");
+  }
+
+  /**
+   * Ritorna una vista in sola lettura sulle righe [r0, r1), senza copie:
+   * gli elementi della vista sono un intervallo contiguo degli elementi
+   * ordinati, individuato con due ricerche binarie.
+   *
+   * @param r0 prima riga della vista
+   * @param r1 riga successiva all'ultima
+   *
+   * @return vista sulle righe
+   *
+   * @throw std::out_of_range se r0 > r1 o r1 > get_rows()
+   */
+  sparse_view<T, E, A, I> rows(I r0, I r1) const
+  {
+    return block(r0, 0, r1, _ncols);
+  }
+
+  /**
+   * Ritorna una vista in sola lettura sulla riga r, senza copie.
+   *
+   * @param r indice di riga
+   *
+   * @return vista sulla riga
+   *
+   * @throw std::out_of_range se r >= get_rows()
+   */
+  sparse_view<T, E, A, I> row(I r) const
+  {
+    if (r >= _nrows)
+      throw std::out_of_range("sparse_matrix: riga fuori dalla matrice");
+    return rows(r, r + 1);
+  }
+
+  /**
+   * Ritorna una vista in sola lettura sul blocco di righe [r0, r1) e
+   * colonne [c0, c1), senza copie. La vista usa coordinate relative al
+   * blocco e resta valida finche' la matrice non viene modificata.
+   *
+   * @param r0 prima riga del blocco
+   * @param c0 prima colonna del blocco
+   * @param r1 riga successiva all'ultima
+   * @param c1 colonna successiva all'ultima
+   *
+   * @return vista sul blocco
+   *
+   * @throw std::out_of_range se il blocco non e' contenuto nella matrice
+   */
+  sparse_view<T, E, A, I> block(I r0, I c0, I r1, I c1) const
+  {
+    if (r0 > r1 || c0 > c1 || r1 > _nrows || c1 > _ncols)
+      throw std::out_of_range("sparse_matrix: blocco fuori dalla matrice");
+    return sparse_view<T, E, A, I>(this, r0, c0, r1, c1);
+  }
+
+private:
+  // Le viste accedono direttamente agli array ordinati
+  friend class sparse_view<T, E, A, I>;
+
+  I *_row_idx;            ///< array degli indici di riga degli elementi
+  I *_col_idx;            ///< array degli indici di colonna degli elementi
+  T *_values;             ///< array dei valori degli elementi
+  T _default;             ///< valore di default della matrice
+  std::size_t _size;      ///< numero di elementi inseriti nella matrice
+  std::size_t _capacity;  ///< numero di elementi allocati negli array
+  std::size_t *_row_ptr;  ///< indice di riga opzionale (offset in stile CSR)
+  std::size_t _indexed_rows; ///< numero di righe coperte da _row_ptr
+  I _nrows;               ///< numero di righe della matrice
+  I _ncols;               ///< numero di colonne della matrice
+  bool _fixed_shape;      ///< true se le dimensioni sono state dichiarate
+  E equals_;              ///< oggetto funtore per l'uguaglianza
+  A _alloc;               ///< allocatore degli array della matrice
+
+  typedef std::allocator_traits<A> alloc_traits;
+  typedef typename alloc_traits::template rebind_alloc<I>
+      index_allocator;
+  typedef std::allocator_traits<index_allocator> index_traits;
+  typedef typename alloc_traits::template rebind_alloc<std::size_t>
+      offset_allocator;
+  typedef std::allocator_traits<offset_allocator> offset_traits;
+
+  /**
+   * Funzione di supporto che scambia tutto il contenuto di due matrici
+   * tranne gli allocatori.
+   */
+  void swap_contents(sparse_matrix &other)
+  {
+    std::swap(_row_idx, other._row_idx);
+    std::swap(_col_idx, other._col_idx);
+    std::swap(_values, other._values);
+    std::swap(_size, other._size);
+    std::swap(_capacity, other._capacity);
+    std::swap(_row_ptr, other._row_ptr);
+    std::swap(_indexed_rows, other._indexed_rows);
+    std::swap(_nrows, other._nrows);
+    std::swap(_ncols, other._ncols);
+    std::swap(_fixed_shape, other._fixed_shape);
+    std::swap(_default, other._default);
+    std::swap(equals_, other.equals_);
+  }
+
+  /**
+   * Funzioni di supporto che scambiano gli allocatori solo se il tratto
+   * di propagazione lo prevede: gli allocatori che non si propagano, come
+   * std::pmr::polymorphic_allocator, possono non essere assegnabili.
+   */
+  void swap_allocators(sparse_matrix &other, std::true_type)
+  {
+    using std::swap;
+    swap(_alloc, other._alloc);
+  }
+
+  void swap_allocators(sparse_matrix &, std::false_type) {}
+
+  /**
+   * Funzione di supporto degli assegnamenti: acquisisce il contenuto di
+   * tmp, costruita con l'allocatore che this deve avere al termine, e le
+   * lascia il contenuto precedente insieme all'allocatore che lo ha
+   * allocato.
+   */
+  template <typename Propagate>
+  void adopt(sparse_matrix &tmp, Propagate propagate)
+  {
+    swap_contents(tmp);
+    swap_allocators(tmp, propagate);
+  }
+
+  /**
+   * Funzione di supporto che svuota una matrice i cui array sono stati
+   * acquisiti da un'altra, senza liberarli.
+   */
+  void forget()
+  {
+    _row_idx = nullptr;
+    _col_idx = nullptr;
+    _values = nullptr;
+    _size = 0;
+    _capacity = 0;
+    _row_ptr = nullptr;
+    _indexed_rows = 0;
+    if (!_fixed_shape)
+    {
+      _nrows = 0;
+      _ncols = 0;
+    }
+  }
+
+  /**
+   * Funzione di supporto che distrugge i primi n valori di un array
+   * allocato con l'allocatore della matrice. Per T con distruttore banale
+   * non esegue alcuna operazione.
+   *
+   * @param values array dei valori
+   * @param n numero di valori da distruggere
+   */
+  void destroy(T *values, std::size_t n)
+  {
+    if (!std::is_trivially_destructible<T>::value)
+      for (std::size_t i = 0; i < n; i++)
+        alloc_traits::destroy(_alloc, values + i);
+  }
+
+  /**
+   * Funzione di supporto che libera i tre array della matrice, di
+   * capacita' capacity, dopo averne distrutto i primi size valori.
+   */
+  void release(I *rows, I *cols, T *values,
+               std::size_t size, std::size_t capacity)
+  {
+    if (values != nullptr)
+    {
+      destroy(values, size);
+      alloc_traits::deallocate(_alloc, values, capacity);
+    }
+
+    index_allocator index_alloc(_alloc);
+    if (rows != nullptr)
+      index_traits::deallocate(index_alloc, rows, capacity);
+    if (cols != nullptr)
+      index_traits::deallocate(index_alloc, cols, capacity);
+  }
+
+  /**
+   * Funzione di supporto che rialloca i tre array della matrice con
+   * spazio per capacity elementi, spostando gli elementi gia' inseriti.
+   * In caso di eccezione la matrice resta invariata.
+   *
+   * @param capacity numero di elementi che i nuovi array possono contenere
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  void reallocate(std::size_t capacity)
+  {
+    relocate(capacity, nullptr);
+  }
+
+  /**
+   * Funzione di supporto che sposta gli elementi in nuovi array di capacita'
+   * capacity: l'i-esimo elemento dei nuovi array e' l'elemento perm[i]
+   * della matrice (l'i-esimo se perm e' nullo).
+   * In caso di eccezione la matrice resta invariata.
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  void relocate(std::size_t capacity, const std::size_t *perm)
+  {
+    index_allocator index_alloc(_alloc);
+    I *rows = nullptr;
+    I *cols = nullptr;
+    T *values = nullptr;
+    std::size_t i = 0;
+
+    try
+    {
+      rows = index_traits::allocate(index_alloc, capacity);
+      cols = index_traits::allocate(index_alloc, capacity);
+      values = alloc_traits::allocate(_alloc, capacity);
+      for (; i < _size; i++)
+      {
+        std::size_t src = perm == nullptr ? i : perm[i];
+        alloc_traits::construct(_alloc, values + i,
+                                std::move_if_noexcept(_values[src]));
+        rows[i] = _row_idx[src];
+        cols[i] = _col_idx[src];
+      }
+    }
+    catch (...)
+    {
+      release(rows, cols, values, i, capacity);
+      throw;
+    }
+
+    release(_row_idx, _col_idx, _values, _size, _capacity);
+
+    _row_idx = rows;
+    _col_idx = cols;
+    _values = values;
+    _capacity = capacity;
+  }
+
+  /**
+   * Funzione di supporto che ritorna la posizione del primo elemento con
+   * coordinate non minori di (row, col) nell'ordine per righe, oppure
+   * _size se tale elemento non esiste.
+   *
+   * @param row indice di riga
+   * @param col indice di colonna
+   *
+   * @return posizione dell'elemento (row, col) o del suo successore
+   */
+  std::size_t lower_bound(I row, I col) const
+  {
+    if (_row_ptr != nullptr)
+    {
+      if (row >= _indexed_rows)
+        return _size;
+      return std::lower_bound(_col_idx + _row_ptr[row],
+                              _col_idx + _row_ptr[row + 1], col) -
+             _col_idx;
+    }
+
+    std::size_t first = 0;
+    std::size_t count = _size;
+    while (count > 0)
+    {
+      std::size_t step = count / 2;
+      std::size_t mid = first + step;
+      if (_row_idx[mid] < row || (_row_idx[mid] == row && _col_idx[mid] < col))
+      {
+        first = mid + 1;
+        count -= step + 1;
+      }
+      else
+        count = step;
+    }
+    return first;
+  }
+
+  /**
+   * Funzione di supporto che ritorna la posizione del primo elemento
+   * successivo alla riga row.
+   */
+  std::size_t row_limit(I row) const
+  {
+    if (row == std::numeric_limits<I>::max())
+      return _size;
+    return lower_bound(row + 1, 0);
+  }
+
+  /**
+   * Funzione di supporto comune alle versioni di add(): inserisce, sovrascrive
+   * o ignora il valore, copiandolo o spostandolo secondo il tipo di value.
+   */
+  template <typename V>
+  void put(V &&value, const I &row, const I &col)
+  {
+    check_bounds(row, col);
+
+    try
+    {
+      // un'unica ricerca binaria individua l'eventuale elemento (row, col)
+      std::size_t pos = lower_bound(row, col);
+      bool found = pos < _size && _row_idx[pos] == row && _col_idx[pos] == col;
+
+      /*
+      scrivere il default in una cella occupata equivale a rimuoverne
+      l'elemento, cosi' da non accumulare elementi inutili.
+      */
+      if (found && equals_(value, _default))
+      {
+        erase_at(pos);
+        return;
+      }
+
+      /* 
+      controllo nel caso in cui venga richiesto l'inserimento di un valore gia'
+      presente in corrispondenza della cella (row, col) in input, in tal caso
+      l'inserimento viene ignorato.
+      */
+      if (equals_(value, found ? _values[pos] : _default))
+      {
+        return;
+      }
+
+      /* 
+      controllo nel caso in cui vengo richiesto l'inserimento di un nuovo 
+      valore in una cella gia' occupata con un valore diverso da quello in input.
+      In tal caso viene sovrascritto il valore attuale con quello nuovo.
+      */
+      else if (found)
+      {
+        _values[pos] = std::forward<V>(value);
+      }
+
+      else
+      {
+        // copia locale: value potrebbe riferirsi a un elemento della matrice
+        T tmp(std::forward<V>(value));
+        insert_at(pos, tmp, row, col);
+      }
+    }
+    catch (...)
+    {
+      clear();
+      throw;
+    }
+  }
+
+  /**
+   * Funzione di supporto che accoda un elemento in fondo agli array, senza
+   * ricerche ne' ordinamento, ampliando la capacita' se necessario.
+   * Non aggiorna le dimensioni della matrice.
+   *
+   * @throw eccezione di allocazione della memoria o lanciata da T
+   */
+  template <typename V>
+  void append(V &&value, I row, I col)
+  {
+    if (_size == _capacity)
+      reallocate(_capacity == 0 ? 4 : 2 * _capacity);
+
+    alloc_traits::construct(_alloc, _values + _size, std::forward<V>(value));
+    _row_idx[_size] = row;
+    _col_idx[_size] = col;
+    _size++;
+  }
+
+  /**
+   * Funzione di supporto che inserisce un nuovo elemento nella posizione
+   * pos, spostando di un posto verso destra gli elementi successivi.
+   * Il valore viene spostato nella matrice.
+   *
+   * @param pos posizione ordinata del nuovo elemento
+   * @param value valore da inserire
+   * @param row indice di riga del nuovo elemento
+   * @param col indice di colonna del nuovo elemento
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  void insert_at(std::size_t pos, T &value, I row, I col)
+  {
+    // l'indice di riga non e' piu' valido dopo un nuovo inserimento
+    drop_row_index();
+
+    // riallocazione degli array solo quando la capacita' e' esaurita
+    if (_size == _capacity)
+      reallocate(_capacity == 0 ? 4 : 2 * _capacity);
+
+    if (pos == _size)
+      alloc_traits::construct(_alloc, _values + _size, std::move(value));
+    else
+    {
+      alloc_traits::construct(_alloc, _values + _size,
+                              std::move(_values[_size - 1]));
+      std::move_backward(_values + pos, _values + _size - 1,
+                         _values + _size);
+      _values[pos] = std::move(value);
+
+      std::copy_backward(_row_idx + pos, _row_idx + _size,
+                         _row_idx + _size + 1);
+      std::copy_backward(_col_idx + pos, _col_idx + _size,
+                         _col_idx + _size + 1);
+    }
+
+    _row_idx[pos] = row;
+    _col_idx[pos] = col;
+    _size++;
+
+    if (row >= _nrows)
+      _nrows = row + 1;
+    if (col >= _ncols)
+      _ncols = col + 1;
+  }
+
+  /**
+   * Funzione di supporto che rimuove l'elemento in posizione pos, spostando
+   * di un posto verso sinistra gli elementi successivi.
+   */
+  void erase_at(std::size_t pos)
+  {
+    I col = _col_idx[pos];
+
+    std::move(_values + pos + 1, _values + _size, _values + pos);
+    std::copy(_row_idx + pos + 1, _row_idx + _size, _row_idx + pos);
+    std::copy(_col_idx + pos + 1, _col_idx + _size, _col_idx + pos);
+    _size--;
+    destroy(_values + _size, 1);
+    drop_row_index();
+
+    if (!_fixed_shape)
+    {
+      _nrows = _size == 0 ? 0 : _row_idx[_size - 1] + 1;
+      if (col + 1 == _ncols)
+        shrink_shape();
+    }
+  }
+
+  /**
+   * Funzione di supporto che ricalcola le dimensioni di una matrice senza
+   * dimensioni fisse dopo una rimozione: l'indice di riga massimo e' quello
+   * dell'ultimo elemento, quello di colonna richiede una scansione.
+   */
+  void shrink_shape()
+  {
+    if (_fixed_shape)
+      return;
+
+    _nrows = _size == 0 ? 0 : _row_idx[_size - 1] + 1;
+    _ncols = 0;
+    for (std::size_t i = 0; i < _size; i++)
+      if (_col_idx[i] >= _ncols)
+        _ncols = _col_idx[i] + 1;
+  }
+
+  /**
+   * Funzione di supporto che verifica che (row, col) sia all'interno di una
+   * matrice con dimensioni fisse.
+   *
+   * @throw std::out_of_range se (row, col) e' al di fuori della matrice
+   */
+  void check_bounds(I row, I col) const
+  {
+    if (_fixed_shape && (row >= _nrows || col >= _ncols))
+      throw std::out_of_range("sparse_matrix: coordinate fuori dalla matrice");
+
+    check_index(row, col);
+  }
+
+  /**
+   * Funzione di supporto per ordinare gli elementi della matrice
+   * in ordine crescente di riga e, a parita' di riga, di colonna.
+   *
+   * Pensata per dati caricati in blocco: le coordinate sono compattate in
+   * chiavi a 64 bit (riga << 32 | colonna) e ordinate con un radix sort
+   * LSD stabile a cifre di 16 bit, saltando le cifre costanti; gli
+   * elementi vengono poi spostati una sola volta nell'ordine trovato.
+   * Con indici oltre i 32 bit le coordinate non stanno in una chiave a
+   * 64 bit e si ricorre a un ordinamento stabile per confronto.
+   * Elementi con le stesse coordinate mantengono l'ordine relativo.
+   *
+   * @throw eccezione di allocazione della memoria
+   */
+  void sort()
+  {
+    bool sorted = true;
+    for (std::size_t i = 1; i < _size && sorted; i++)
+      sorted = !precedes(i, i - 1);
+    if (sorted)
+      return;
+
+    if (sizeof(I) > 4)
+    {
+      std::vector<std::size_t> perm(_size);
+      for (std::size_t i = 0; i < _size; i++)
+        perm[i] = i;
+      std::stable_sort(perm.begin(), perm.end(),
+                       [this](std::size_t a, std::size_t b) {
+                         return precedes(a, b);
+                       });
+      relocate(_capacity, perm.data());
+      drop_row_index();
+      return;
+    }
+
+    std::vector<std::uint64_t> keys(_size), keys_tmp(_size);
+    std::vector<std::size_t> perm(_size), perm_tmp(_size);
+    for (std::size_t i = 0; i < _size; i++)
+    {
+      keys[i] = key(i);
+      perm[i] = i;
     }
 
-    // Operatore di iterazione pre-incremento
-    iterator &operator++()
+    for (unsigned int shift = 0; shift < 64; shift += 16)
     {
-      _el = _el++;
-      return *this;
+      std::vector<std::size_t> count(65536 + 1, 0);
+      for (std::size_t i = 0; i < _size; i++)
+        count[((keys[i] >> shift) & 0xFFFF) + 1]++;
+
+      // cifra costante per tutti gli elementi: passata inutile
+      if (count[((keys[0] >> shift) & 0xFFFF) + 1] == _size)
+        continue;
+
+      for (unsigned int d = 0; d < 65536; d++)
+        count[d + 1] += count[d];
+
+      for (std::size_t i = 0; i < _size; i++)
+      {
+        std::size_t dst = count[(keys[i] >> shift) & 0xFFFF]++;
+        keys_tmp[dst] = keys[i];
+        perm_tmp[dst] = perm[i];
+      }
+      keys.swap(keys_tmp);
+      perm.swap(perm_tmp);
     }
 
-    // Uguaglianza
-    bool operator==(const iterator &other) const { return (_el == other._el); }
+    // spostamento degli elementi nei nuovi array secondo la permutazione
+    relocate(_capacity, perm.data());
+    drop_row_index();
+  }
 
-    // Diversita'
-    bool operator!=(const iterator &other) const { return (_el != other._el); }
+  typedef sparse_kernels::dispatch<T> kernels; ///< kernel di calcolo per T
+  typedef sparse_kernels::row_dispatch<T, I> row_kernels; ///< kernel di riga
 
-    friend class const_iterator;
+  /**
+   * Funzione di supporto che calcola le righe [r0, r1) di y = M * x,
+   * partendo dall'elemento in posizione k (il primo della riga r0).
+   *
+   * @param base contributo delle celle di default, d * sum(x)
+   * @param dot kernel del prodotto di riga
+   */
+  void multiply_rows(const T *x, T *y, const T &base, I r0,
+                     I r1, std::size_t k,
+                     typename row_kernels::row_dot_fn dot) const
+  {
+    for (I r = r0; r < r1; r++)
+    {
+      std::size_t first = k;
+      while (k < _size && _row_idx[k] == r)
+        k++;
+      y[r] = base + dot(_values + first, _col_idx + first, k - first, x,
+                        _default);
+    }
+  }
 
-    // Uguaglianza con un const_iterator
-    bool operator==(const const_iterator &other) const
+  /**
+   * Funzione di supporto che ordina gli elementi per colonna e, a parita'
+   * di colonna, per riga, con un counting sort stabile sugli indici di
+   * colonna.
+   *
+   * @param col_ptr in uscita, offset di colonna (get_columns() + 1 elementi)
+   *
+   * @return permutazione: l'i-esimo elemento in ordine di colonna e'
+   *         l'elemento perm[i] della matrice
+   */
+  std::vector<std::size_t>
+  column_order(std::vector<std::uint64_t> &col_ptr) const
+  {
+    col_ptr.assign(static_cast<std::size_t>(_ncols) + 1, 0);
+    for (std::size_t i = 0; i < _size; i++)
+      col_ptr[_col_idx[i] + 1]++;
+    for (I c = 0; c < _ncols; c++)
+      col_ptr[c + 1] += col_ptr[c];
+
+    std::vector<std::uint64_t> next(col_ptr.begin(), col_ptr.end() - 1);
+    std::vector<std::size_t> perm(_size);
+    for (std::size_t i = 0; i < _size; i++)
+      perm[next[_col_idx[i]]++] = i;
+    return perm;
+  }
+
+  /**
+   * Funzione di supporto che divide le righe in al piu' threads blocchi
+   * contigui con circa lo stesso numero di elementi inseriti.
+   *
+   * @param threads numero di blocchi desiderato (0 = thread hardware)
+   *
+   * @return confini dei blocchi: il blocco t copre le righe
+   *         [bounds[t], bounds[t + 1])
+   */
+  std::vector<I> partition_rows(unsigned int threads) const
+  {
+    if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    if (threads > _nrows)
+      threads = std::max<unsigned int>(1u, _nrows);
+
+    std::vector<I> bounds(1, 0);
+    for (unsigned int t = 1; t < threads; t++)
     {
-      return (_el == other._el);
+      std::uint64_t k = static_cast<std::uint64_t>(_size) * t / threads;
+      I r = k < _size ? _row_idx[k] : _nrows;
+      if (r > bounds.back())
+        bounds.push_back(r);
     }
+    if (_nrows > bounds.back() || bounds.size() == 1)
+      bounds.push_back(_nrows);
+    return bounds;
+  }
 
-    // Diversita' con un const_iterator
-    bool operator!=(const const_iterator &other) const
+  /**
+   * Dati condivisi tra i thread di un prodotto matrice-matrice.
+   */
+  struct spgemm_context
+  {
+    const sparse_matrix &b;                ///< secondo fattore
+    I ncols;                    ///< colonne del risultato
+    T dc;                                  ///< default del risultato
+    std::vector<std::size_t> b_row_ptr;   ///< offset delle righe di b
+    std::vector<T> col_corr;               ///< dA * sum_k B'(k, j)
+    std::vector<I> corr_cols;   ///< colonne con col_corr non nullo
+
+    spgemm_context(const sparse_matrix &a, const sparse_matrix &other)
+        : b(other), ncols(other._ncols)
     {
-      return (_el != other._el);
+      const I inner = std::max(a._ncols, other._nrows);
+      dc = static_cast<T>(inner) * a._default * other._default;
+
+      b_row_ptr.assign(inner + 1, 0);
+      for (std::size_t k = 0; k < b._size; k++)
+        b_row_ptr[b._row_idx[k] + 1]++;
+      for (I r = 0; r < inner; r++)
+        b_row_ptr[r + 1] += b_row_ptr[r];
+
+      if (a._default != T())
+      {
+        col_corr.assign(ncols, T());
+        for (std::size_t k = 0; k < b._size; k++)
+          col_corr[b._col_idx[k]] += b._values[k] - b._default;
+        for (I j = 0; j < ncols; j++)
+        {
+          col_corr[j] *= a._default;
+          if (col_corr[j] != T())
+            corr_cols.push_back(j);
+        }
+      }
     }
+  };
 
-  private:
-    element **_el;
+  /**
+   * Accumulatore denso di una riga del prodotto, privato di ogni thread.
+   */
+  struct spgemm_workspace
+  {
+    std::vector<T> acc;             ///< somma parziale per colonna
+    std::vector<I> mark; ///< ultima riga che ha toccato la colonna
+    std::vector<I> cols; ///< colonne toccate dalla riga corrente
+    T row_corr;                     ///< dB * sum_k A'(i, k)
+    bool dense;                     ///< true se la riga e' tutta non default
 
-    // Classe container
-    friend class sparse_matrix;
+    spgemm_workspace(I ncols)
+        : acc(ncols, T()), mark(ncols, static_cast<I>(-1)),
+          row_corr(), dense(false) {}
+  };
 
-    // Costruttore privato di inizializzazione usato dalla classe container
-    iterator(element **element) : _el(element) {}
+  /**
+   * Funzione di supporto che elabora la riga r del prodotto, i cui elementi
+   * di M partono dalla posizione k (aggiornata alla riga successiva).
+   * Raccoglie in ws le colonne toccate e, se numeric, ne accumula i valori.
+   *
+   * @return numero massimo di elementi della riga r del risultato
+   */
+  std::size_t spgemm_row(const spgemm_context &ctx, I r,
+                         std::size_t &k, spgemm_workspace &ws,
+                         bool numeric) const
+  {
+    const sparse_matrix &b = ctx.b;
+    const std::size_t first = k;
+    while (k < _size && _row_idx[k] == r)
+      k++;
+
+    ws.cols.clear();
+    ws.row_corr = T();
+    for (std::size_t q = first; q < k; q++)
+      ws.row_corr += _values[q] - _default;
+    ws.row_corr *= b._default;
+    ws.dense = ws.row_corr != T();
+
+    if (ws.dense && !numeric)
+      return ctx.ncols;
+
+    for (std::size_t q = first; q < k; q++)
+    {
+      const I inner = _col_idx[q];
+      const T a = _values[q] - _default;
+      for (std::size_t p = ctx.b_row_ptr[inner];
+           p < ctx.b_row_ptr[inner + 1]; p++)
+      {
+        const I j = b._col_idx[p];
+        if (ws.mark[j] != r)
+        {
+          ws.mark[j] = r;
+          ws.acc[j] = T();
+          ws.cols.push_back(j);
+        }
+        if (numeric)
+          ws.acc[j] += a * (b._values[p] - b._default);
+      }
+    }
 
-  }; // END class iterator
+    for (std::size_t q = 0; q < ctx.corr_cols.size(); q++)
+    {
+      const I j = ctx.corr_cols[q];
+      if (ws.mark[j] != r)
+      {
+        ws.mark[j] = r;
+        ws.acc[j] = T();
+        ws.cols.push_back(j);
+      }
+    }
+
+    return ws.dense ? ctx.ncols : ws.cols.size();
+  }
 
   /**
-   * Ritorna l'iteratore al primo elemento della matrice.
+   * Funzione di supporto che scrive in ordine di colonna i valori non di
+   * default della riga r calcolata in ws.
    *
-   * @return iteratore al primo elemento della matrice
+   * @return numero di elementi scritti
    */
-  iterator begin() { return iterator(_elem); }
+  std::size_t spgemm_store(const spgemm_context &ctx, I r,
+                           spgemm_workspace &ws, T *values,
+                           I *cols) const
+  {
+    E equals(equals_);
+    std::size_t n = 0;
+
+    if (ws.dense)
+    {
+      for (I j = 0; j < ctx.ncols; j++)
+      {
+        T v = ctx.dc + ws.row_corr;
+        if (ws.mark[j] == r)
+          v += ws.acc[j];
+        if (!ctx.col_corr.empty())
+          v += ctx.col_corr[j];
+        if (!equals(v, ctx.dc))
+        {
+          values[n] = v;
+          cols[n++] = j;
+        }
+      }
+      return n;
+    }
+
+    std::sort(ws.cols.begin(), ws.cols.end());
+    for (std::size_t q = 0; q < ws.cols.size(); q++)
+    {
+      const I j = ws.cols[q];
+      T v = ctx.dc + ws.acc[j];
+      if (!ctx.col_corr.empty())
+        v += ctx.col_corr[j];
+      if (!equals(v, ctx.dc))
+      {
+        values[n] = v;
+        cols[n++] = j;
+      }
+    }
+    return n;
+  }
 
   /**
-   * Ritorna l'iteratore all'ultimo elemento della matrice.
+   * Funzioni di supporto che riservano la memoria per le terne di
+   * from_triplets() quando la lunghezza della sequenza e' nota a priori.
+   */
+  template <typename It>
+  void reserve_for(It first, It last, std::forward_iterator_tag)
+  {
+    reserve(static_cast<std::size_t>(std::distance(first, last)));
+  }
+
+  template <typename It>
+  void reserve_for(It, It, std::input_iterator_tag) {}
+
+  /**
+   * Funzione di supporto che ritorna la chiave di ordinamento a 64 bit
+   * dell'i-esimo elemento, per indici di al piu' 32 bit.
+   */
+  std::uint64_t key(std::size_t i) const
+  {
+    return (static_cast<std::uint64_t>(_row_idx[i]) << 32) |
+           static_cast<std::uint64_t>(_col_idx[i]);
+  }
+
+  /**
+   * Funzione di supporto che ritorna true se l'elemento a precede
+   * l'elemento b nell'ordine (riga, colonna).
+   */
+  bool precedes(std::size_t a, std::size_t b) const
+  {
+    return _row_idx[a] < _row_idx[b] ||
+           (_row_idx[a] == _row_idx[b] && _col_idx[a] < _col_idx[b]);
+  }
+}; // END class sparse_matrix
+
+/**
+ * Classe che implementa una vista in sola lettura, senza copie, su un
+ * blocco rettangolare di una sparse_matrix (vedi sparse_matrix::rows(),
+ * sparse_matrix::row() e sparse_matrix::block()).
+ *
+ * La vista usa coordinate relative al blocco ed espone la stessa
+ * interfaccia di lettura della matrice (dimensioni, default,
+ * operator(), iteratori costanti), per cui funziona con evaluate().
+ * Gli elementi del blocco vengono raggiunti sfruttando l'ordinamento per
+ * (riga, colonna): una ricerca binaria individua l'inizio del blocco e,
+ * quando il blocco non copre tutte le colonne, una per riga salta le
+ * colonne esterne. La vista e' valida finche' la matrice non viene
+ * modificata o distrutta.
+ *
+ * @brief Vista su un blocco di una matrice sparsa
+ *
+ * @param T tipo del dato
+ * @param E funtore di comparazione (==) di due dati di tipo T
+ * @param A allocatore della matrice
+ * @param I tipo degli indici della matrice
+ */
+template <typename T, typename E, typename A, typename I>
+class sparse_view
+{
+public:
+  typedef sparse_matrix<T, E, A, I> matrix_type;
+  typedef typename matrix_type::const_element const_element;
+  typedef I index_type;
+
+  /**
+   * Ritorna il numero di righe della vista.
    *
-   * @return iteratore all'ultimo elemento della matrice
+   * @return numero di righe
    */
-  iterator end() { return iterator(_elem + _size); }
+  I get_rows() const { return _r1 - _r0; }
 
   /**
-   * Iteratore costante della matrice.
-   * 
-   * @brief Iteratore costante della matrice
+   * Ritorna il numero di colonne della vista.
+   *
+   * @return numero di colonne
+   */
+  I get_columns() const { return _c1 - _c0; }
+
+  /**
+   * Ritorna il numero di elementi memorizzati nel blocco: O(1) se il
+   * blocco copre tutte le colonne, altrimenti proporzionale agli elementi
+   * del blocco.
+   *
+   * @return numero di elementi memorizzati
    */
+  std::size_t get_size() const
+  {
+    if (full_width())
+      return _last - _first;
+
+    std::size_t n = 0;
+    for (const_iterator it = begin(); it != end(); ++it)
+      n++;
+    return n;
+  }
+
+  /**
+   * Ritorna il valore di default della matrice.
+   *
+   * @return valore di default
+   */
+  const T &get_default() const { return _m->_default; }
+
+  /**
+   * Ritorna la riga della matrice corrispondente alla riga 0 della vista.
+   *
+   * @return prima riga del blocco
+   */
+  I first_row() const { return _r0; }
+
+  /**
+   * Ritorna la colonna della matrice corrispondente alla colonna 0 della
+   * vista.
+   *
+   * @return prima colonna del blocco
+   */
+  I first_column() const { return _c0; }
 
+  /**
+   * Operatore di lettura coordinate, relative al blocco, O(log n).
+   *
+   * @param row indice di riga (minore di get_rows())
+   * @param col indice di colonna (minore di get_columns())
+   *
+   * @return valore dell'elemento corrispondente alle coordinate (row, col)
+   */
+  const T &operator()(const I row, const I col) const
+  {
+    return (*_m)(_r0 + row, _c0 + col);
+  }
+
+  /**
+   * Iteratore costante della vista: visita gli elementi memorizzati nel
+   * blocco per riga e, a parita' di riga, per colonna, con coordinate
+   * relative al blocco.
+   *
+   * @brief Iteratore costante della vista
+   */
   class const_iterator
   {
   public:
     typedef std::forward_iterator_tag iterator_category;
-    typedef ptrdiff_t difference_type;
-    typedef const element *pointer;
-    typedef const element &reference;
+    typedef const_element value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef typename matrix_type::template arrow_proxy<const_element> pointer;
+    typedef const_element reference;
 
-    const_iterator() : _el(0) {}
+    const_iterator() : _v(nullptr), _pos(0) {}
 
-    const_iterator(const const_iterator &other) : _el(other._el) {}
-
-    const_iterator &operator=(const const_iterator &other)
+    // Ritorna il dato riferito dall'iteratore (dereferenziamento)
+    reference operator*() const
     {
-      _el = other._el;
-      return *this;
+      const matrix_type &m = *_v->_m;
+      return const_element(m._values[_pos],
+                           static_cast<I>(m._row_idx[_pos] - _v->_r0),
+                           static_cast<I>(m._col_idx[_pos] - _v->_c0));
     }
 
-    ~const_iterator() {}
-
-    // Ritorna il dato riferito dall'iteratore (dereferenziamento)
-    reference operator*() const { return **_el; }
-
-    // Operatore di iterazione post-incremento
-    pointer operator->() const { return *_el; }
+    // Ritorna il puntatore al dato riferito dall'iteratore
+    pointer operator->() const { return pointer(**this); }
 
     // Operatore di iterazione post-incremento
     const_iterator operator++(int)
     {
       const_iterator temp(*this);
-      _el = ++_el;
+      ++(*this);
       return temp;
     }
+
     // Operatore di iterazione pre-incremento
     const_iterator &operator++()
     {
-      _el = _el++;
+      _pos = _v->skip(_pos + 1);
       return *this;
     }
 
     // Uguaglianza
     bool operator==(const const_iterator &other) const
     {
-      return (_el == other._el);
+      return _pos == other._pos;
     }
 
     // Diversita'
     bool operator!=(const const_iterator &other) const
     {
-      return (_el != other._el);
-    }
-
-    friend class iterator;
-
-    // Uguaglianza con un iterator
-    bool operator==(const iterator &other) const
-    {
-      return (_el == other._el);
-    }
-
-    // Diversita' con un iterator
-    bool operator!=(const iterator &other) const
-    {
-      return (_el != other._el);
-    }
-
-    // Costruttore di conversione
-    const_iterator(const iterator &other) : _el(other._el) {}
-
-    // Operatore di assegnamento
-    const_iterator &operator=(const iterator &other)
-    {
-      _el = other._el;
-      return *this;
+      return _pos != other._pos;
     }
 
   private:
-    element **_el;
+    const sparse_view *_v; // vista visitata
+    std::size_t _pos;      // posizione corrente negli array della matrice
 
     // Classe container
-    friend class sparse_matrix;
+    friend class sparse_view;
 
     // Costruttore privato di inizializzazione usato dalla classe container
-    const_iterator(const element **element) : _el(element) {}
+    const_iterator(const sparse_view *v, std::size_t pos) : _v(v), _pos(pos) {}
 
   }; // END class const_iterator
 
   /**
-   * Ritorna l'iteratore al primo elemento della matrice.
-   * 
-   * @return iteratore al primo elemento della matrice
-	*/
-  const_iterator begin() const { return const_iterator(_elem); }
+   * Ritorna l'iteratore al primo elemento del blocco.
+   *
+   * @return iteratore al primo elemento del blocco
+   */
+  const_iterator begin() const { return const_iterator(this, skip(_first)); }
 
   /**
-   * Ritorna l'iteratore all'ultimo elemento della matrice.
-   * 
-   * @return iteratore all'ultimo elemento della matrice
-	*/
-  const_iterator end() const { return const_iterator(_elem + _size); }
+   * Ritorna l'iteratore alla fine del blocco.
+   *
+   * @return iteratore alla fine del blocco
+   */
+  const_iterator end() const { return const_iterator(this, _last); }
 
 private:
-  element **_elem;    ///< puntatore all'array di elementi della matrice
-  T _default;         ///< valore di default della matrice
-  unsigned int _size; ///< numero di elementi inseriti nella matrice
-  E equals_;          ///< oggetto funtore per l'uguaglianza
+  const matrix_type *_m; ///< matrice osservata
+  I _r0;                 ///< prima riga del blocco
+  I _c0;                 ///< prima colonna del blocco
+  I _r1;                 ///< riga successiva all'ultima
+  I _c1;                 ///< colonna successiva all'ultima
+  std::size_t _first;    ///< primo elemento della riga _r0
+  std::size_t _last;     ///< primo elemento dopo la riga _r1 - 1
 
-  /**
-   * Funzione di supporto per ordinare gli elementi della matrice.
-   */
-  void sort()
-  {
-    // riordina le righe in ordine crescente
-    for (int i = 1; i < _size; i++)
-    {
-      element *curr = _elem[i];
-      int j = i - 1;
-      element *prev = _elem[j];
+  // Classe che costruisce le viste
+  friend class sparse_matrix<T, E, A, I>;
 
-      while (j >= 0 && prev->row > curr->row)
-      {
-        _elem[j + 1] = _elem[j];
-        j--;
-        prev = _elem[j];
-      }
+  // Costruttore privato usato da sparse_matrix::block()
+  sparse_view(const matrix_type *m, I r0, I c0, I r1, I c1)
+      : _m(m), _r0(r0), _c0(c0), _r1(r1), _c1(c1),
+        _first(m->lower_bound(r0, 0)),
+        _last(r1 == r0 ? _first : m->lower_bound(r1, 0)) {}
 
-      _elem[j + 1] = curr;
-    }
+  bool full_width() const { return _c0 == 0 && _c1 >= _m->_ncols; }
 
-    // riordina le colonne in ordine crescente aventi medesima riga
-    for (int i = 0; i < _size; i++)
+  /**
+   * Funzione di supporto che ritorna la prima posizione >= pos di un
+   * elemento interno al blocco, oppure _last: gli elementi fuori dalle
+   * colonne del blocco vengono saltati con una ricerca binaria.
+   */
+  std::size_t skip(std::size_t pos) const
+  {
+    while (pos < _last)
     {
-      for (int j = i + 1; j < _size; j++)
-      {
-        element *curr = _elem[j];
-        int k = j - 1;
-        element *prev = _elem[k];
-        while (curr->row == prev->row && k >= 0 && prev->col > curr->col)
-        {
-          _elem[k + 1] = _elem[k];
-          k--;
-          prev = _elem[k];
-        }
-        _elem[k + 1] = curr;
-        i = j;
-      }
+      const I r = _m->_row_idx[pos];
+      const I c = _m->_col_idx[pos];
+      if (c < _c0)
+        pos = _m->lower_bound(r, _c0);
+      else if (c >= _c1)
+        pos = r + 1 < _r1 ? _m->lower_bound(r + 1, _c0) : _last;
+      else
+        break;
     }
+    return pos;
   }
-}; // END class sparse_matrix
+
+}; // END class sparse_view
 
 /**
- * Ridefinizione dell'operatore di stream per la stampa 
- * degli elementi inseriti nella matrice.
+ * Ridefinizione dell'operatore di stream per la stampa
+ * degli elementi inseriti nella matrice, una sola passata sugli elementi
+ * con l'output accumulato in un buffer.
  *
  * @param ostream oggetto stream di output
  * @param sm matrice sparsa da stampare
@@ -609,26 +2982,33 @@ private:
  * @return reference allo stream di output
  */
 
-template <typename T, typename E>
-std::ostream &operator<<(std::ostream &ostream, const sparse_matrix<T, E> &sm)
+template <typename T, typename E, typename A, typename I>
+std::ostream &operator<<(std::ostream &ostream,
+                         const sparse_matrix<T, E, A, I> &sm)
 {
+  sparse_format::writer w(ostream);
+
   if (sm.get_size() == 0)
-    ostream << sm.get_default() << std::endl;
-  else
   {
-    typename sparse_matrix<T, E>::const_iterator it, ite;
-
-    it = sm.begin();
-    ite = sm.end();
+    w.value(sm.get_default());
+    w.put('\n');
+    w.flush();
+    ostream.flush();
+    return ostream;
+  }
 
-    while (it != ite)
-    {
-      ostream << "[" << it->row
-              << ", " << it->col
-              << "] = " << it->value << '\n';
-      it++;
-    }
+  typename sparse_matrix<T, E, A, I>::const_iterator it, ite;
+  for (it = sm.begin(), ite = sm.end(); it != ite; ++it)
+  {
+    w.put('[');
+    w.value(it->row);
+    w.text(", ", 2);
+    w.value(it->col);
+    w.text("] = ", 4);
+    w.value(it->value);
+    w.put('\n');
   }
+  w.flush();
 
   return ostream;
 }
@@ -643,30 +3023,81 @@ std::ostream &operator<<(std::ostream &ostream, const sparse_matrix<T, E> &sm)
  * @return numero di elementi di M che soddisfano P
  */
 
-template <typename T, typename E, typename P>
-unsigned int evaluate(const sparse_matrix<T, E> &M, P pred)
+template <typename T, typename E, typename A, typename I, typename P>
+std::uint64_t evaluate(const sparse_matrix<T, E, A, I> &M, P pred)
 {
-  int n = 0; // numero di valori in M che soddisfano il predicato pred
-  typename sparse_matrix<T, E>::const_iterator it, ite;
+  std::uint64_t n = 0; // numero di valori in M che soddisfano pred
+  typename sparse_matrix<T, E, A, I>::const_iterator it, ite;
   it = M.begin();
   ite = M.end();
 
-  if (M.get_size() > 0)
+  if (pred(M.get_default()))
   {
-    if (pred(M.get_default()))
-    {
-      n += (M.get_rows() * M.get_columns()) - M.get_size();
-    }
+    n += static_cast<std::uint64_t>(M.get_rows()) * M.get_columns() -
+         M.get_size();
+  }
 
-    while (it != ite)
-    {
-      if (pred(it->value))
-        n++;
-      it++;
-    }
+  while (it != ite)
+  {
+    if (pred(it->value))
+      n++;
+    it++;
   }
 
   return n;
 }
 
-#endif // PROJECT_H
\ No newline at end of file
+/**
+ * Versione parallela di evaluate: gli elementi inseriti vengono divisi in
+ * threads intervalli contigui, ciascuno contato da un thread con un proprio
+ * contatore, e i contatori vengono sommati alla fine. pred viene copiato
+ * in ogni thread e deve poter essere invocato in modo concorrente.
+ *
+ * @param M matrice sparsa di tipo T
+ * @param pred predicato da verificare
+ * @param threads numero di thread da usare (0 = thread hardware)
+ *
+ * @return numero di elementi di M che soddisfano P
+ *
+ * @throw std::system_error se non e' possibile creare un thread
+ */
+template <typename T, typename E, typename A, typename I, typename P>
+std::uint64_t evaluate(const sparse_matrix<T, E, A, I> &M, P pred,
+                       unsigned int threads)
+{
+  std::uint64_t n = M.count_stored(pred, threads);
+
+  if (pred(M.get_default()))
+    n += static_cast<std::uint64_t>(M.get_rows()) * M.get_columns() -
+         M.get_size();
+
+  return n;
+}
+
+/**
+ * Funzione generica globale che data una vista M su un blocco di una
+ * matrice sparsa e un predicato P ritorna quanti valori del blocco
+ * (compresi i default) soddisfano P.
+ *
+ * @param M vista su un blocco di una matrice sparsa
+ * @param pred predicato da verificare
+ *
+ * @return numero di elementi del blocco che soddisfano P
+ */
+template <typename T, typename E, typename A, typename I, typename P>
+std::uint64_t evaluate(const sparse_view<T, E, A, I> &M, P pred)
+{
+  std::uint64_t n = 0;       // elementi memorizzati che soddisfano pred
+  std::uint64_t stored = 0;  // elementi memorizzati nel blocco
+  typename sparse_view<T, E, A, I>::const_iterator it;
+  for (it = M.begin(); it != M.end(); ++it, ++stored)
+    if (pred(it->value))
+      n++;
+
+  if (pred(M.get_default()))
+    n += static_cast<std::uint64_t>(M.get_rows()) * M.get_columns() - stored;
+
+  return n;
+}
+
+#endif // PROJECT_H